@@ -14,7 +14,28 @@
 #define TRUE 1
 #endif
 
-static volatile uint32_t int_done;
+#define QUEUE_LENGTH     4  /* Power of two, at least CMDBUF_COUNT. */
+
+typedef struct vg_lite_queue{
+    uint32_t  cmd_address;
+    uint32_t  cmd_size;
+    vg_lite_os_async_event_t *event;
+}
+vg_lite_queue_t;
+
+/* Submitted command buffers, a ring indexed by free running counters: head
+ * is advanced by vg_lite_os_submit(), tail by the interrupt handler when the
+ * GPU completes the buffer at the tail. The buffer at the tail runs on the
+ * GPU, the next one is started from the interrupt handler. */
+typedef struct vg_lite_os{
+    vg_lite_queue_t   ring[QUEUE_LENGTH];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+}
+vg_lite_os_t;
+
+static vg_lite_os_t os_obj = {0};
+static volatile uint32_t int_flags;
 static uint32_t curContext;
 static void* pTLS;
 
@@ -63,15 +84,27 @@ void vg_lite_os_sleep(uint32_t msec)
     SDK_DelayAtLeastUs(msec * 1000, SDK_DEVICE_MAXIMUM_CPU_CLOCK_FREQUENCY);
 }
 
+/* Start the buffer at the tail of the ring. */
+static void start_tail(void)
+{
+    vg_lite_queue_t* node = &os_obj.ring[os_obj.tail % QUEUE_LENGTH];
+
+    vg_lite_hal_poke(VG_LITE_HW_CMDBUF_ADDRESS, node->cmd_address);
+    vg_lite_hal_poke(VG_LITE_HW_CMDBUF_SIZE, (node->cmd_size +7)/8 );
+}
+
 int32_t vg_lite_os_initialize(void)
 {
-    int_done = TRUE;
+    os_obj.head = 0;
+    os_obj.tail = 0;
+    int_flags = 0;
     return VG_LITE_SUCCESS;
 }
 
 void vg_lite_os_deinitialize(void)
 {
-    int_done = FALSE;
+    /* Let the GPU drain the ring. */
+    while(os_obj.tail != os_obj.head);
 }
 
 int32_t vg_lite_os_lock()
@@ -86,23 +119,45 @@ int32_t vg_lite_os_unlock()
 
 int32_t vg_lite_os_submit(uint32_t context, uint32_t physical, uint32_t offset, uint32_t size, vg_lite_os_async_event_t *event)
 {
+    vg_lite_queue_t* node;
+    uint32_t primask;
+
     curContext = context;
-    
-    /* Wait previous command done */
-    while(!int_done);
-    
-     /* Clear interrupt done flag */
-    int_done = FALSE;
-    
-    vg_lite_hal_poke(VG_LITE_HW_CMDBUF_ADDRESS, physical + offset);
-    vg_lite_hal_poke(VG_LITE_HW_CMDBUF_SIZE, (size +7)/8 );
+
+    /* Only block when every slot is in flight. */
+    while(os_obj.head - os_obj.tail >= QUEUE_LENGTH);
+
+    *event = VG_LITE_IN_QUEUE;
+    node = &os_obj.ring[os_obj.head % QUEUE_LENGTH];
+    node->cmd_address = physical + offset;
+    node->cmd_size = size;
+    node->event = event;
+
+    primask = DisableGlobalIRQ();
+    /* An idle GPU is started here, a busy one by the interrupt handler. */
+    if(os_obj.head++ == os_obj.tail)
+        start_tail();
+    EnableGlobalIRQ(primask);
 
     return VG_LITE_SUCCESS;
 }
 
 int32_t vg_lite_os_wait(uint32_t timeout, vg_lite_os_async_event_t *event)
 {
-    while(!int_done);
+    uint32_t flags;
+    uint32_t primask;
+
+    while(*event == VG_LITE_IN_QUEUE);
+
+    primask = DisableGlobalIRQ();
+    flags = int_flags;
+    int_flags = 0;
+    EnableGlobalIRQ(primask);
+    if (IS_AXI_BUS_ERR(flags))
+    {
+        vg_lite_bus_error_handler();
+    }
+
     return VG_LITE_SUCCESS;
 }
 
@@ -111,11 +166,15 @@ void vg_lite_os_IRQHandler(void)
     uint32_t flags = vg_lite_hal_peek(VG_LITE_INTR_STATUS);
 
     if (flags) {
-        /* Set interrupt done flags. */
-        int_done = TRUE;
-        if (IS_AXI_BUS_ERR(flags))
+        /* Combine with current interrupt flags. */
+        int_flags |= flags;
+
+        /* Retire the running buffer and start the next one. */
+        if(os_obj.tail != os_obj.head)
         {
-            vg_lite_bus_error_handler();
+            *os_obj.ring[os_obj.tail % QUEUE_LENGTH].event = VG_LITE_HW_FINISHED;
+            if(++os_obj.tail != os_obj.head)
+                start_tail();
         }
     }
 }
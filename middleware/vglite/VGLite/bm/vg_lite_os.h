@@ -3,7 +3,9 @@
 
 #include <stdint.h>
 
-typedef uint32_t  vg_lite_os_async_event_t; /* Not used, just for API consistent*/
+#define vg_lite_os_event_state(event)   (*(event))
+
+typedef volatile uint32_t  vg_lite_os_async_event_t; /* State of the command buffer. */
 /*!
 @brief  Set the value in a task’s thread local storage array.
 */
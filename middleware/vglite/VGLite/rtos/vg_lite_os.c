@@ -11,6 +11,7 @@
 #define IS_AXI_BUS_ERR(x) ((x)&(1U << 31))
 
 #define ISR_WAIT_TIME   0x1FFFF
+#define ISR_WAIT_TICKS  (ISR_WAIT_TIME/portTICK_PERIOD_MS)
 #define MAX_MUTEX_TIME  100
 #define TASK_WAIT_TIME  20
 
@@ -20,7 +21,7 @@
 #define QUEUE_TASK_PRIO  (configMAX_PRIORITIES - 1)
 #endif /* QUEUE_TASK_PRIO */
 #define QUEUE_TASK_SIZE  1024
-#define QUEUE_LENGTH     8
+#define QUEUE_LENGTH     8  /* Power of two, at least TASK_LENGTH. */
 #define MAX_QUEUE_WAIT_NUM  10
 
 #ifndef FALSE
@@ -36,12 +37,29 @@ typedef struct vg_lite_queue{
     uint32_t  cmd_offset;
     uint32_t  cmd_size;
     vg_lite_os_async_event_t *event;
+    int32_t   status;   /* Event state once done: the fence of the buffer. */
+    uint32_t  context;
+    uint8_t   chained;  /* Relies on the state left by the buffer before it. */
 }
 vg_lite_queue_t;
 
+/* Submitted command buffers, a ring of descriptors indexed by free running
+ * counters, tail <= done <= issued <= head:
+ * [issued, head) are waiting, [done, issued) is running on the GPU (one at
+ * most), [tail, done) have completed and wait for the queue task to signal
+ * their events. The next buffer is started from the completion interrupt,
+ * so the GPU does not idle for the task wake-up between buffers.
+ * Waiting buffers are started by task priority, first come first served
+ * between equal priorities. */
 typedef struct vg_lite_os{
-    TaskHandle_t     task_hanlde;
-    QueueHandle_t    queue_handle;
+    TaskHandle_t      task_hanlde;
+    vg_lite_queue_t   ring[QUEUE_LENGTH];
+    volatile uint32_t head;
+    volatile uint32_t issued;
+    volatile uint32_t done;
+    volatile uint32_t tail;
+    TickType_t        dispatched;   /* Tick the running buffer was started at. */
+    uint32_t          priority[TASK_LENGTH];
 }
 vg_lite_os_t;
 
@@ -49,7 +67,6 @@ static SemaphoreHandle_t mutex;
 static vg_lite_os_t os_obj = {0};
 
 SemaphoreHandle_t semaphore[TASK_LENGTH] = {NULL};
-SemaphoreHandle_t command_semaphore = NULL;
 SemaphoreHandle_t int_queue;
 volatile uint32_t int_flags;
 uint32_t curContext;
@@ -64,87 +81,139 @@ void __attribute__((weak)) vg_lite_bus_error_handler()
      return;
 }
 
-/* command queue function */
-void command_queue(void * parameters)
+#define QUEUE_PRIORITY(i) \
+    os_obj.priority[os_obj.ring[(i) % QUEUE_LENGTH].event->semaphore_id]
+
+/* Start the next waiting buffer if the GPU is idle. Runs with interrupts
+ * masked: in a critical section or in the interrupt handler. */
+static void dispatch_next(void)
 {
-    vg_lite_queue_t* peek_queue;
-    uint32_t  even_got;
-    BaseType_t  ret;
+    vg_lite_queue_t node;
+    uint32_t pick, i;
+
+    if(os_obj.issued != os_obj.done || os_obj.issued == os_obj.head)
+        return;
 
-    os_obj.queue_handle = xQueueCreate(QUEUE_LENGTH, sizeof(vg_lite_queue_t * ));
-    if(os_obj.queue_handle == NULL)
+    /* A chained buffer was queued with nothing ahead of it, it stays first. */
+    pick = os_obj.issued;
+    if(!os_obj.ring[pick % QUEUE_LENGTH].chained)
     {
-        /*command queue create fail, delete queue task */
-        vTaskDelete(NULL);
+        for(i = pick + 1; i != os_obj.head; i++)
+        {
+            if(QUEUE_PRIORITY(i) > QUEUE_PRIORITY(pick))
+                pick = i;
+        }
     }
 
-    command_semaphore = xSemaphoreCreateCounting(30,0);
+    /* Move the picked buffer to the front, keeping the order of the others. */
+    node = os_obj.ring[pick % QUEUE_LENGTH];
+    for(i = pick; i != os_obj.issued; i--)
+        os_obj.ring[i % QUEUE_LENGTH] = os_obj.ring[(i - 1) % QUEUE_LENGTH];
+    os_obj.ring[os_obj.issued % QUEUE_LENGTH] = node;
+
+    vg_lite_hal_poke(VG_LITE_HW_CMDBUF_ADDRESS, node.cmd_physical + node.cmd_offset);
+    vg_lite_hal_poke(VG_LITE_HW_CMDBUF_SIZE, (node.cmd_size +7)/8 );
+    curContext = node.context;
+    os_obj.dispatched = xTaskGetTickCountFromISR();
+    os_obj.issued++;
+}
+
+/* Mark the running buffer done with the given state and start the next one. */
+static void complete_running(int32_t status)
+{
+    if(os_obj.issued == os_obj.done)
+        return;
+
+    os_obj.ring[os_obj.done % QUEUE_LENGTH].status = status;
+    os_obj.done++;
+    dispatch_next();
+}
+
+/* command queue function: retires the completed buffers. */
+void command_queue(void * parameters)
+{
+    vg_lite_queue_t job;
+    uint32_t flags, issued;
+    TickType_t wait = ISR_WAIT_TICKS, running = 0;
+
     while(1)
     {
-        even_got = 0;
-        if (xSemaphoreTake((SemaphoreHandle_t)command_semaphore, portMAX_DELAY) == pdTRUE) {
-            if(uxQueueMessagesWaiting(os_obj.queue_handle))
+        /* One notification may stand for several completions. */
+        if(ulTaskNotifyTake(pdTRUE, wait) == 0)
+        {
+            /* The timeout counts from the last wake-up, a buffer started later
+             * gets the rest of its time. */
+            taskENTER_CRITICAL();
+            issued = os_obj.issued;
+            if(issued != os_obj.done)
+                running = xTaskGetTickCount() - os_obj.dispatched;
+            taskEXIT_CRITICAL();
+
+            wait = ISR_WAIT_TICKS;
+            if(issued != os_obj.done && running < ISR_WAIT_TICKS)
             {
-                ret = xQueueReceive(os_obj.queue_handle,
-                                  (void*) &peek_queue,
-                                  TASK_WAIT_TIME/portTICK_PERIOD_MS);
-                if(ret == pdPASS)
-                {
-#if defined(PRINT_COMMAND_BUFFER)
-                    int i = 0;
-                    for(i=0;i < (peek_queue->cmd_size + 3) / 4; i++)
-                    {
-                        if(i % 4 == 0)
-                            printf("\r\n");
-                        printf("0x%08x ",((uint32_t*)(peek_queue->cmd_physical + peek_queue->cmd_offset))[i]);
-                    }
-#endif
-                    vg_lite_hal_poke(VG_LITE_HW_CMDBUF_ADDRESS, peek_queue->cmd_physical + peek_queue->cmd_offset);
-                    vg_lite_hal_poke(VG_LITE_HW_CMDBUF_SIZE, (peek_queue->cmd_size +7)/8 );
+                wait = ISR_WAIT_TICKS - running;
+                continue;
+            }
 
-                    if(vg_lite_hal_wait_interrupt(ISR_WAIT_TIME, (uint32_t)~0, &even_got))
-                        peek_queue->event->signal = VG_LITE_HW_FINISHED;
-                    else
-#if defined(PRINT_DEBUG_REGISTER)
-                    {
-                        unsigned int debug;
-                        unsigned int iter;
-                        for(iter =0; iter < 16 ; iter ++)
-                        {
-                             vg_lite_hal_poke(0x470, iter);
-                             debug = vg_lite_hal_peek(0x450);
-                             printf("0x450[%d] = 0x%x\n", iter,debug);
-                        }
-                        for(iter =0; iter < 16 ; iter ++)
-                        {
-                             vg_lite_hal_poke(0x470, iter <<16);
-                             debug = vg_lite_hal_peek(0x454);
-                             printf("0x454[%d] = 0x%x\n", iter,debug);
-                        }
-                        for(iter =0; iter < 16 ; iter ++)
-                        {
-                             vg_lite_hal_poke(0x478, iter);
-                             debug = vg_lite_hal_peek(0x468);
-                             printf("0x468[%d] = 0x%x\n", iter,debug);
-                        }
-                        for(iter =0; iter < 16 ; iter ++)
-                        {
-                             vg_lite_hal_poke(0x478, iter);
-                             debug = vg_lite_hal_peek(0x46C);
-                             printf("0x46C[%d] = 0x%x\n", iter,debug);
-                        }
-#endif
-                        /* wait timeout */
-                        peek_queue->event->signal = VG_LITE_IDLE;
+            /* No completion for the whole wait: give up on the running buffer. */
+            if(issued != os_obj.done)
+            {
 #if defined(PRINT_DEBUG_REGISTER)
-                    }
+                unsigned int debug;
+                unsigned int iter;
+                for(iter =0; iter < 16 ; iter ++)
+                {
+                     vg_lite_hal_poke(0x470, iter);
+                     debug = vg_lite_hal_peek(0x450);
+                     printf("0x450[%d] = 0x%x\n", iter,debug);
+                }
+                for(iter =0; iter < 16 ; iter ++)
+                {
+                     vg_lite_hal_poke(0x470, iter <<16);
+                     debug = vg_lite_hal_peek(0x454);
+                     printf("0x454[%d] = 0x%x\n", iter,debug);
+                }
+                for(iter =0; iter < 16 ; iter ++)
+                {
+                     vg_lite_hal_poke(0x478, iter);
+                     debug = vg_lite_hal_peek(0x468);
+                     printf("0x468[%d] = 0x%x\n", iter,debug);
+                }
+                for(iter =0; iter < 16 ; iter ++)
+                {
+                     vg_lite_hal_poke(0x478, iter);
+                     debug = vg_lite_hal_peek(0x46C);
+                     printf("0x46C[%d] = 0x%x\n", iter,debug);
+                }
 #endif
-                    if(semaphore[peek_queue->event->semaphore_id]){
-                        xSemaphoreGive(semaphore[peek_queue->event->semaphore_id]);
-                    }
+                /* wait timeout, unless it completed in the meantime */
+                taskENTER_CRITICAL();
+                if(os_obj.issued == issued)
+                    complete_running(VG_LITE_IDLE);
+                taskEXIT_CRITICAL();
+            }
+        }
 
-                    vg_lite_os_free((void *) peek_queue);
-                }
+        taskENTER_CRITICAL();
+        flags = int_flags;
+        int_flags = 0;
+        taskEXIT_CRITICAL();
+        if (IS_AXI_BUS_ERR(flags))
+        {
+            vg_lite_bus_error_handler();
+        }
+
+        while(os_obj.tail != os_obj.done)
+        {
+            taskENTER_CRITICAL();
+            job = os_obj.ring[os_obj.tail % QUEUE_LENGTH];
+            os_obj.tail++;
+            taskEXIT_CRITICAL();
+
+            job.event->signal = job.status;
+            if(semaphore[job.event->semaphore_id]){
+                xSemaphoreGive(semaphore[job.event->semaphore_id]);
             }
         }
     }
@@ -252,35 +321,56 @@ int32_t vg_lite_os_unlock()
 int32_t vg_lite_os_submit(uint32_t context, uint32_t physical, uint32_t offset, uint32_t size, vg_lite_os_async_event_t *event)
 {
     vg_lite_queue_t* queue_node;
+    uint32_t wait = 0;
 
-    if(os_obj.queue_handle == NULL)
+    if(os_obj.task_hanlde == NULL)
         return VG_LITE_NOT_SUPPORT;
 
-    queue_node = (vg_lite_queue_t*) vg_lite_os_malloc(sizeof(vg_lite_queue_t));
-    if(queue_node == NULL)
-        return VG_LITE_MULTI_THREAD_FAIL;
-
-    queue_node->cmd_physical = physical;
-    queue_node->cmd_offset = offset;
-    queue_node->cmd_size = size;
-    queue_node->event = event;
+#if defined(PRINT_COMMAND_BUFFER)
+    int i = 0;
+    for(i=0;i < (size + 3) / 4; i++)
+    {
+        if(i % 4 == 0)
+            printf("\r\n");
+        printf("0x%08x ",((uint32_t*)(physical + offset))[i]);
+    }
+#endif
 
     /* Current command buffer has been sent to the command queue. */
     event->signal = VG_LITE_IN_QUEUE;
 
-    if(xQueueSend(os_obj.queue_handle,
-                  (void *) &queue_node,
-                  ISR_WAIT_TIME/portTICK_PERIOD_MS) != pdTRUE)
+    /* Own the event before publishing, the queue task signals it when done. */
+    if (vg_lite_os_wait_event(event) != VG_LITE_SUCCESS)
         return VG_LITE_MULTI_THREAD_FAIL;
-    curContext = context;
 
-    if (vg_lite_os_wait_event(event) == VG_LITE_SUCCESS) {
-        if(xSemaphoreGive(command_semaphore) != pdTRUE)
+    taskENTER_CRITICAL();
+    while(os_obj.head - os_obj.tail >= QUEUE_LENGTH)
+    {
+        /* Cannot happen with one buffer in flight per task, but be safe. */
+        taskEXIT_CRITICAL();
+        if(++wait > MAX_QUEUE_WAIT_NUM)
+        {
+            vg_lite_os_signal_event(event);
             return VG_LITE_MULTI_THREAD_FAIL;
-        return VG_LITE_SUCCESS;
+        }
+        vTaskDelay(1);
+        taskENTER_CRITICAL();
     }
+    queue_node = &os_obj.ring[os_obj.head % QUEUE_LENGTH];
+    queue_node->cmd_physical = physical;
+    queue_node->cmd_offset = offset;
+    queue_node->cmd_size = size;
+    queue_node->event = event;
+    queue_node->status = VG_LITE_IN_QUEUE;
+    queue_node->context = context;
+    /* Same condition as vg_lite_os_query_context_switch() reporting no switch. */
+    queue_node->chained = (os_obj.issued == os_obj.head) &&
+                          (!curContext || curContext == context);
+    os_obj.head++;
+    dispatch_next();
+    taskEXIT_CRITICAL();
 
-    return VG_LITE_MULTI_THREAD_FAIL;
+    return VG_LITE_SUCCESS;
 }
 
 int32_t vg_lite_os_wait(uint32_t timeout, vg_lite_os_async_event_t *event)
@@ -309,13 +399,20 @@ void vg_lite_os_IRQHandler(void)
         /* Combine with current interrupt flags. */
         int_flags |= flags;
 
+        /* The running buffer is done, keep the GPU busy with the next one
+         * and let the queue task signal the completion. */
+        complete_running(VG_LITE_HW_FINISHED);
+        if(os_obj.task_hanlde){
+            vTaskNotifyGiveFromISR(os_obj.task_hanlde, &xHigherPriorityTaskWoken);
+        }
+
         /* Wake up any waiters. */
         if(int_queue){
             xSemaphoreGiveFromISR(int_queue, &xHigherPriorityTaskWoken);
-            if(xHigherPriorityTaskWoken != pdFALSE )
-            {
-                portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
-            }
+        }
+        if(xHigherPriorityTaskWoken != pdFALSE )
+        {
+            portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
         }
     }
 }
@@ -387,6 +484,7 @@ int32_t vg_lite_os_delete_event(vg_lite_os_async_event_t *event)
         vSemaphoreDelete(semaphore[event->semaphore_id]);
         semaphore[event->semaphore_id] = NULL;
     }
+    os_obj.priority[event->semaphore_id] = 0;
 
     return VG_LITE_SUCCESS;
 }
@@ -413,7 +511,26 @@ int32_t vg_lite_os_signal_event(vg_lite_os_async_event_t *event)
 
 int8_t vg_lite_os_query_context_switch(uint32_t context)
 {
-   if(!curContext || curContext == context)
-        return FALSE;
-    return TRUE;
+    int8_t switched = TRUE;
+
+    /* The GPU state is only known when nothing waits to be started: a
+     * waiting buffer of higher priority may run before this one. */
+    taskENTER_CRITICAL();
+    if(os_obj.issued == os_obj.head && (!curContext || curContext == context))
+        switched = FALSE;
+    taskEXIT_CRITICAL();
+
+    return switched;
+}
+
+int32_t vg_lite_os_set_priority(vg_lite_os_async_event_t *event, uint32_t priority)
+{
+    if (event->semaphore_id >= TASK_LENGTH)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    taskENTER_CRITICAL();
+    os_obj.priority[event->semaphore_id] = priority;
+    taskEXIT_CRITICAL();
+
+    return VG_LITE_SUCCESS;
 }
@@ -118,4 +118,9 @@ int32_t vg_lite_os_signal_event(vg_lite_os_async_event_t *event);
 */
 int8_t vg_lite_os_query_context_switch(uint32_t context);
 
+/*!
+@brief  Set the submit priority of the task owning the event.
+*/
+int32_t vg_lite_os_set_priority(vg_lite_os_async_event_t *event, uint32_t priority);
+
 #endif
@@ -84,7 +84,13 @@ vg_lite_error_t vg_lite_kernel(vg_lite_kernel_command_t command, void * data);
 #define CMDBUF_SWAP(context)    (context).command_buffer_current = \
                                     ((context).command_buffer_current + 1) % CMDBUF_COUNT
 
-#if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
+/* Command buffer auto sizing, see vg_lite_set_command_buffer_auto_size. */
+#define CMDBUF_MIN_SIZE         (8 << 10)
+#define CMDBUF_SIZE_ALIGN       (1 << 10)
+#define CMDBUF_SHRINK_FRAMES    32      /* Frames without extra rollovers before shrinking. */
+#define TS_SHRINK_FRAMES        32      /* Frames with small paths before shrinking the tessellation window. */
+
+#if !defined(ONE_TASK_SUPPORT)
 #ifndef CMDBUF_IN_QUEUE
 #define CMDBUF_IN_QUEUE(context, id) \
         (vg_lite_os_event_state(&(context)->async_event[(id)]) == VG_LITE_IN_QUEUE)
@@ -132,6 +138,20 @@ goto ErrorHandler
 
 #define FC_BURST_BYTES  64
 #define FC_BIT_TO_BYTES 64
+#define FC_TARGET_COUNT 4       /* Render targets keeping their own fast clear cache. */
+#define FC_BUFFER(context)  (context).fcBuffer[(context).fcCurrent]
+
+/* Deferred render graph capacity, see vg_lite_enable_deferred. */
+#ifndef GRAPH_MAX_OPS
+#define GRAPH_MAX_OPS       64
+#endif
+#ifndef GRAPH_MAX_PASSES
+#define GRAPH_MAX_PASSES    16
+#endif
+#ifndef GRAPH_MAX_EDGES
+#define GRAPH_MAX_EDGES     64
+#endif
+#define GRAPH_RECORDING(context)    ((context).graph.ops != NULL && !(context).graph.replaying)
 
 #define MIN(a, b) ((a) > (b) ? (b) : (a))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -184,6 +204,9 @@ static uint32_t command_buffer_size = VG_LITE_COMMAND_BUFFER_SIZE;
 #define STATES_COUNT         424
 /* STATES_COUNT size + return command size */
 #define CONTEXT_BUFFER_SIZE  STATES_COUNT * 2 * 4 + 8
+/* Registers 0x0A00 - 0x0BFF, tracked to restore them on buffer rollover. */
+#define STATE_SHADOW_BASE    0x0A00
+#define STATE_SHADOW_COUNT   0x200
 
 #define UPDATE_BOUNDING_BOX(bbx, point)                                 \
     do {                                                                \
@@ -208,18 +231,55 @@ typedef struct vg_lite_ftable {
     uint32_t    ftflag;
 } vg_lite_ftable_t;
 
-typedef struct vg_lite_states {
-    uint32_t state;
-    uint8_t  init;
-}vg_lite_states_t;
-
-#if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
-typedef struct vg_lite_hardware {
-    vg_lite_states_t hw_states[STATES_COUNT];
-} vg_lite_hardware_t;
-
-static vg_lite_hardware_t hw = {0};
-#endif
+typedef enum vg_lite_op_type {
+    VG_LITE_OP_CLEAR,
+    VG_LITE_OP_BLIT,
+    VG_LITE_OP_BLIT_RECT,
+    VG_LITE_OP_DRAW,
+    VG_LITE_OP_PATTERN,
+    VG_LITE_OP_RADIAL,
+} vg_lite_op_type_t;
+
+/* A draw call recorded in deferred mode, replayed through its own API entry. */
+typedef struct vg_lite_op {
+    vg_lite_op_type_t           type;
+    vg_lite_buffer_t          * target;
+    vg_lite_buffer_t          * source;                     /* Image or pattern read by the op. */
+    vg_lite_path_t            * path;
+    vg_lite_radial_gradient_t * grad;
+    vg_lite_matrix_t            matrix[2];
+    uint8_t                     has_matrix[2];
+    uint8_t                     has_rect;
+    vg_lite_rectangle_t         rectangle;                  /* Clear area. */
+    uint32_t                    rect[4];                    /* Blit source rectangle. */
+    vg_lite_fill_t              fill_rule;
+    vg_lite_blend_t             blend;
+    vg_lite_color_t             color;
+    vg_lite_filter_t            filter;
+    vg_lite_pattern_mode_t      pattern_mode;
+    uint32_t                    scissor_enabled;            /* Scissor and premultiply states at record time. */
+    int32_t                     scissor[4];
+    uint32_t                    premultiply_enabled;
+    int32_t                     next;                       /* Next op of the same pass, -1 for the last. */
+} vg_lite_op_t;
+
+/* Consecutive ops to one render target. */
+typedef struct vg_lite_pass {
+    vg_lite_buffer_t          * target;
+    int32_t                     first;
+    int32_t                     last;
+    uint32_t                    sealed;                     /* Has successors, new ops to the target open a new pass. */
+} vg_lite_pass_t;
+
+typedef struct vg_lite_graph {
+    vg_lite_op_t              * ops;                        /* NULL unless deferred mode is enabled. */
+    uint32_t                    op_count;
+    vg_lite_pass_t              passes[GRAPH_MAX_PASSES];
+    uint32_t                    pass_count;
+    uint8_t                     edges[GRAPH_MAX_EDGES][2];  /* Pass dependencies: from, to. */
+    uint32_t                    edge_count;
+    uint32_t                    replaying;
+} vg_lite_graph_t;
 
 typedef struct vg_lite_context {
     vg_lite_kernel_context_t    context;
@@ -235,18 +295,22 @@ typedef struct vg_lite_context {
     vg_lite_buffer_t          * rtbuffer;                   /* DDRLess: this is used as composing buffer. */
 
 #if VG_TARGET_FAST_CLEAR
-    vg_lite_buffer_t            fcBuffer;                   /* Buffer used for fast clear cache. */
+    vg_lite_buffer_t            fcBuffer[FC_TARGET_COUNT];  /* Fast clear caches of the recent render targets. */
+    vg_lite_buffer_t          * fcTarget[FC_TARGET_COUNT];  /* Render target owning each fast clear cache. */
+    uint32_t                    fcCurrent;                  /* Fast clear cache of the current render target. */
+    uint32_t                    fcNext;                     /* Next fast clear cache to recycle. */
+    uint32_t                    fcClearValue[FC_TARGET_COUNT];  /* Clear value of each fast clear cache. */
     uint32_t                    clearValue;
 #endif
 
     uint32_t                    scissor_enabled;
     int32_t                     scissor[4];                 /* Scissor area: x, y, width, height. */
 
-    uint32_t                    start_offset;
-    uint32_t                    end_offset;
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
     uint32_t                    ts_init;                    /* Indicates whether tessellation buffer states are initialized or not. */
     uint32_t                    ts_record[TS_STATE_COUNT];     /* Tessellation buffer initial states record. */
+    uint32_t                    state_shadow[STATE_SHADOW_COUNT];       /* Last value written to each register. */
+    uint32_t                    state_dirty[STATE_SHADOW_COUNT / 32];   /* Registers written since the last flush. */
 #endif
     uint32_t                    chip_id;
     uint32_t                    chip_rev;
@@ -260,6 +324,21 @@ typedef struct vg_lite_context {
     uint32_t                    clut_used[4];               /* check if used index. */
 
     vg_lite_ftable_t            s_ftable;
+
+    vg_lite_command_buffer_stats_t  cmdbuf_stats;
+    uint32_t                    frame_rollovers;            /* Usage of the frame in progress. */
+    uint32_t                    frame_peak;
+    uint32_t                    frame_bytes;
+    uint32_t                    cmdbuf_budget;              /* Auto size budget for both command buffers, 0 if disabled. */
+    uint32_t                    quiet_frames;               /* Frames in a row with at most one rollover. */
+    uint32_t                    quiet_bytes;                /* Most command bytes of those frames. */
+    uint32_t                    ts_budget;                  /* Tessellation auto size budget, 0 if disabled. */
+    int32_t                     ts_box_width;               /* Largest path box of the frame in progress. */
+    int32_t                     ts_box_height;
+    uint32_t                    ts_quiet_frames;            /* Frames in a row whose paths fit the window. */
+    int32_t                     ts_quiet_width;             /* Largest path box of those frames. */
+    int32_t                     ts_quiet_height;
+    vg_lite_graph_t             graph;                      /* Deferred render graph. */
 } vg_lite_context_t;
 
 typedef struct vg_lite_tls{
@@ -744,14 +823,14 @@ vg_lite_error_t _allocate_command_buffer(uint32_t size)
     tls->t_context.command_buffer[1] = tls->t_context.context.command_buffer_logical[1];
 
     tls->t_context.command_buffer_size = size;
+    tls->t_context.cmdbuf_stats.size = size;
     tls->t_context.command_offset[0] = 0;
     tls->t_context.command_offset[1] = 0;
     tls->t_context.command_buffer_current = 0;
-    tls->t_context.start_offset = 0;
-    tls->t_context.end_offset = 0;
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
     tls->t_context.ts_init = 0;
     memset(tls->t_context.ts_record, 0, sizeof(tls->t_context.ts_record));
+    memset(tls->t_context.state_dirty, 0, sizeof(tls->t_context.state_dirty));
 #endif
     return error;
 }
@@ -814,69 +893,57 @@ static uint8_t PackColorComponent(vg_lite_float_t value)
 }
 
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
-static void command_buffer_copy(void *new_cmd, void *old_cmd, uint32_t start, uint32_t end, uint32_t *cmd_count)
+/* Record the states written by the context, so a new command buffer can
+ * start with them when the current one rolls over. */
+static void record_states(vg_lite_context_t *context, uint32_t address, uint32_t count, uint32_t *data)
 {
-    uint32_t i = start,j;
-    uint32_t *p_new_cmd32,*p_cmd32,*temp;
-    uint32_t data_count = 0;
-
-    memset(&hw,0,sizeof(vg_lite_hardware_t));
-    temp = NULL;
-    p_new_cmd32 = (uint32_t *)new_cmd;
-    p_cmd32 = (uint32_t *)old_cmd;
-    while(i < end)
-    {
-        /* data command is 0x40000000 | count, and count = databytes / 8  ,and data command and databytes should align to 8 */
-        if((*p_cmd32 & 0xF0000000) == 0x40000000) {
-            data_count = *p_cmd32 & 0x0FFFFFFF;
-            data_count++;
-            p_cmd32 += 2 * data_count;
-            i += data_count * 8;
-         /* SEMAPHORE command is 0x10000000 | id,stall command is 0x20000000 | id , call command is is 0x20000000 | count,
-            and this three command should occupy 8bytes*/
-        }else if((*p_cmd32 & 0xF0000000) == 0x20000000 || (*p_cmd32 & 0xF0000000) == 0x10000000
-                || (*p_cmd32 & 0xF0000000) == 0x60000000 || (*p_cmd32 & 0xF0000000) == 0x80000000){
-            p_cmd32 += 2;
-            i += 8;
-            /* register command is 0x30000000 | ((count) << 16) | address,
-            and the bytes of this command add register count should align to 8 */
-        }else if((*p_cmd32 & 0xF0000000) == 0x30000000) {
-            /* get register data count */
-            data_count = (*p_cmd32 & 0x0FFFFFFF) >> 16;
-            if(data_count == 1)
-            {
-                temp = p_cmd32 + 1;
-                if(hw.hw_states[*p_cmd32 & 0xff].state != *temp || !hw.hw_states[*p_cmd32 & 0xff].init){
-                    hw.hw_states[*p_cmd32 & 0xff].state = *temp;
-                    hw.hw_states[*p_cmd32 & 0xff].init = 1;
-                    for(j = 0; j < 2; j++) {
-                        *p_new_cmd32 = *p_cmd32;
-                        p_new_cmd32++;
-                        p_cmd32++;
-                        *cmd_count += 4;
-                        i += 4;
-                    }
-                }
-                else
-                {
-                        p_cmd32 += 2;
-                        i += 8;
-                }
-            }else{
-                /* the bytes of register count add register command */
-                data_count++;
-                if(data_count % 2 != 0)
-                    data_count++;
-                for(j = 0; j < data_count; j++) {
-                    *p_new_cmd32 = *p_cmd32;
-                    p_new_cmd32++;
-                    p_cmd32++;
-                    *cmd_count += 4;
-                    i += 4;
-                }
-            }
+    uint32_t i, index;
+
+    for (i = 0; i < count; i++) {
+        index = address + i - STATE_SHADOW_BASE;
+        if (index >= STATE_SHADOW_COUNT)
+            continue;
+
+        context->state_shadow[index] = data[i];
+        context->state_dirty[index / 32] |= 1u << (index % 32);
+    }
+}
+
+/* Emit every register written since the last flush once, with its last
+ * value, consecutive registers grouped in a single state command. */
+static vg_lite_error_t restore_states(vg_lite_context_t *context)
+{
+    uint32_t index = 0, first, count, address, i;
+    uint32_t *cmd;
+
+    while (index < STATE_SHADOW_COUNT) {
+        if (!(context->state_dirty[index / 32] & (1u << (index % 32)))) {
+            /* Skip clean words at once. */
+            index = (context->state_dirty[index / 32] >> (index % 32)) ? index + 1 : (index | 31) + 1;
+            continue;
         }
+
+        first = index;
+        while (index < STATE_SHADOW_COUNT && (context->state_dirty[index / 32] & (1u << (index % 32))))
+            index++;
+        count = index - first;
+
+        /* Keep room for the command, flush and submit. */
+        if (CMDBUF_OFFSET(*context) + VG_LITE_ALIGN(count + 1, 2) * 4 + 56 >= CMDBUF_SIZE(*context))
+            return VG_LITE_OUT_OF_RESOURCES;
+
+        address = first + STATE_SHADOW_BASE;
+        cmd = (uint32_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context));
+        cmd[0] = VG_LITE_STATES(count, address);
+        for (i = 0; i < count; i++)
+            cmd[1 + i] = context->state_shadow[first + i];
+        if (i % 2 == 0)
+            cmd[1 + i] = VG_LITE_NOP();
+
+        CMDBUF_OFFSET(*context) += VG_LITE_ALIGN(count + 1, 2) * 4;
     }
+
+    return VG_LITE_SUCCESS;
 }
 #endif
 
@@ -1600,12 +1667,59 @@ static vg_lite_error_t update_context_buffer()
 }
 #endif
 
+#if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
+/* Submit the full command buffer and continue in the other one. Another
+ * task may use the GPU in between, so the new buffer starts with the
+ * tessellation states and the states this context set since the last flush. */
+static vg_lite_error_t rollover(vg_lite_context_t *context)
+{
+    vg_lite_error_t error;
+
+    VG_LITE_RETURN_ERROR(flush(context));
+    VG_LITE_RETURN_ERROR(submit(context));
+    CMDBUF_SWAP(*context);
+    context->frame_rollovers++;
+
+    if(CMDBUF_IN_QUEUE(&context->context, CMDBUF_INDEX(*context)))
+        VG_LITE_RETURN_ERROR(stall(context, 0));
+
+    RESERVE_BYTES_IN_CMDBUF(*context);
+
+    if(context->ts_init){
+        memcpy(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context), context->ts_record, 80);
+        CMDBUF_OFFSET(*context) += 80;
+    }
+
+    return restore_states(context);
+}
+#else
+/* Make room for bytes more commands, submitting the full command buffer and
+ * continuing in the other one. On bare metal the GPU may still run that one,
+ * it was only queued on submit, also after vg_lite_flush. */
+static vg_lite_error_t reserve_commands(vg_lite_context_t *context, uint32_t bytes)
+{
+    vg_lite_error_t error;
+
+    if (CMDBUF_OFFSET(*context) + bytes >= CMDBUF_SIZE(*context)) {
+        VG_LITE_RETURN_ERROR(submit(context));
+        CMDBUF_SWAP(*context);
+        context->frame_rollovers++;
+    }
+#if defined(_BAREMETAL)
+    if(CMDBUF_IN_QUEUE(&context->context, CMDBUF_INDEX(*context)))
+        VG_LITE_RETURN_ERROR(stall(context, 0));
+#endif
+
+    return VG_LITE_SUCCESS;
+}
+#endif
+
 /* Push a state array into current command buffer. */
 static vg_lite_error_t push_states(vg_lite_context_t * context, uint32_t address, uint32_t count, uint32_t *data)
 {
     uint32_t i;
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
-    uint32_t command_id, index;
+    uint32_t command_id;
 #endif
     vg_lite_error_t error;
     if (!has_valid_command_buffer(context))
@@ -1618,38 +1732,12 @@ static vg_lite_error_t push_states(vg_lite_context_t * context, uint32_t address
 
     /* Reserve enough space in the command buffer for flush and submit */
     if (CMDBUF_OFFSET(*context) + 40 + VG_LITE_ALIGN(count + 1, 2) * 4 >= CMDBUF_SIZE(*context)) {
-        uint32_t cmd_count = 0,start_offset = 0;
-        context->end_offset = CMDBUF_OFFSET(*context);
-        start_offset = context->start_offset;
-        VG_LITE_RETURN_ERROR(flush(context));
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);
-        command_id = CMDBUF_INDEX(*context);
-
-        if(CMDBUF_IN_QUEUE(&context->context, command_id))
-            VG_LITE_RETURN_ERROR(stall(context, 0));
-
-        RESERVE_BYTES_IN_CMDBUF(*context);
-
-        if(context->ts_init){
-            memcpy(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context), context->ts_record, 80);
-            CMDBUF_OFFSET(*context) += 80;
-        }
-
-        /* update start offset */
-        context->start_offset = CMDBUF_OFFSET(*context);
-
-        index = (command_id? 0 : 1);
-        command_buffer_copy((void *)(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)), (void *)(context->command_buffer[index] + start_offset),
-                start_offset, context->end_offset, &cmd_count);
-        CMDBUF_OFFSET(*context) += cmd_count;
+        VG_LITE_RETURN_ERROR(rollover(context));
+    }
 #else
     /* Reserve enough space in the command buffer for flush and submit */
-    if (CMDBUF_OFFSET(*context) + VG_LITE_ALIGN(count + 1, 2) * 4 >= CMDBUF_SIZE(*context)) {
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);
+    VG_LITE_RETURN_ERROR(reserve_commands(context, VG_LITE_ALIGN(count + 1, 2) * 4));
 #endif
-    }
 
     ((uint32_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)))[0] = VG_LITE_STATES(count, address);
 
@@ -1689,6 +1777,9 @@ static vg_lite_error_t push_states(vg_lite_context_t * context, uint32_t address
     }
 #endif
 
+#if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
+    record_states(context, address, count, data);
+#endif
     CMDBUF_OFFSET(*context) += VG_LITE_ALIGN(count + 1, 2) * 4;
 
     return VG_LITE_SUCCESS;
@@ -1699,7 +1790,7 @@ static vg_lite_error_t push_state(vg_lite_context_t * context, uint32_t address,
 {
     vg_lite_error_t error;
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
-    uint32_t command_id, index;
+    uint32_t command_id;
 #endif
     
     if (!has_valid_command_buffer(context))
@@ -1712,38 +1803,12 @@ static vg_lite_error_t push_state(vg_lite_context_t * context, uint32_t address,
 
     /* Reserve enough space in the command buffer for flush and submit */
     if (CMDBUF_OFFSET(*context) + 56 >= CMDBUF_SIZE(*context)) {
-        uint32_t cmd_count = 0,start_offset = 0;
-        context->end_offset = CMDBUF_OFFSET(*context);
-        start_offset = context->start_offset;
-        VG_LITE_RETURN_ERROR(flush(context));
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);
-        command_id = CMDBUF_INDEX(*context);
-
-        if(CMDBUF_IN_QUEUE(&context->context, command_id))
-            VG_LITE_RETURN_ERROR(stall(context, 0));
-
-        RESERVE_BYTES_IN_CMDBUF(*context);
-
-        if(context->ts_init){
-            memcpy(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context), context->ts_record, 80);
-            CMDBUF_OFFSET(*context) += 80;
-        }
-
-        /* update start offset */
-        context->start_offset = CMDBUF_OFFSET(*context);
-
-        index = (command_id? 0 : 1);
-        command_buffer_copy((void *)(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)), (void *)(context->command_buffer[index] + start_offset),
-                start_offset, context->end_offset, &cmd_count);
-        CMDBUF_OFFSET(*context) += cmd_count;
+        VG_LITE_RETURN_ERROR(rollover(context));
+    }
 #else
     /* Reserve enough space in the command buffer for flush and submit */
-    if (CMDBUF_OFFSET(*context) + 16 >= CMDBUF_SIZE(*context)) {
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);
+    VG_LITE_RETURN_ERROR(reserve_commands(context, 16));
 #endif
-    }
 
     ((uint32_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)))[0] = VG_LITE_STATE(address);
     ((uint32_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)))[1] = data;
@@ -1766,6 +1831,10 @@ static vg_lite_error_t push_state(vg_lite_context_t * context, uint32_t address,
     fp = NULL;
 #endif
 
+#if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
+    record_states(context, address, 1, &data);
+#endif
+
     CMDBUF_OFFSET(*context) += 8;
 
     return VG_LITE_SUCCESS;
@@ -1776,7 +1845,7 @@ static vg_lite_error_t push_state_ptr(vg_lite_context_t * context, uint32_t addr
 {
     vg_lite_error_t error;
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
-    uint32_t command_id, index;
+    uint32_t command_id;
 #endif
     uint32_t data = *(uint32_t *) data_ptr;
     if (!has_valid_command_buffer(context))
@@ -1789,38 +1858,12 @@ static vg_lite_error_t push_state_ptr(vg_lite_context_t * context, uint32_t addr
 
     /* Reserve enough space in the command buffer for flush and submit */
     if (CMDBUF_OFFSET(*context) + 56 >= CMDBUF_SIZE(*context)) {
-        uint32_t cmd_count = 0,start_offset = 0;
-        context->end_offset = CMDBUF_OFFSET(*context);
-        start_offset = context->start_offset;
-        VG_LITE_RETURN_ERROR(flush(context));
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);
-        command_id = CMDBUF_INDEX(*context);
-
-        if(CMDBUF_IN_QUEUE(&context->context, command_id))
-            VG_LITE_RETURN_ERROR(stall(context, 0));
-
-        RESERVE_BYTES_IN_CMDBUF(*context);
-
-        if(context->ts_init){
-            memcpy(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context), context->ts_record, 80);
-            CMDBUF_OFFSET(*context) += 80;
-        }
-
-        /* update start offset */
-        context->start_offset = CMDBUF_OFFSET(*context);
-
-        index = (command_id? 0 : 1);
-        command_buffer_copy((void *)(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)), (void *)(context->command_buffer[index] + start_offset),
-                start_offset, context->end_offset, &cmd_count);
-        CMDBUF_OFFSET(*context) += cmd_count;
+        VG_LITE_RETURN_ERROR(rollover(context));
+    }
 #else
     /* Reserve enough space in the command buffer for flush and submit */
-    if (CMDBUF_OFFSET(*context) + 16 >= CMDBUF_SIZE(*context)) {
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);
+    VG_LITE_RETURN_ERROR(reserve_commands(context, 16));
 #endif
-    }
 
     ((uint32_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)))[0] = VG_LITE_STATE(address);
     ((uint32_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)))[1] = data;
@@ -1842,6 +1885,10 @@ static vg_lite_error_t push_state_ptr(vg_lite_context_t * context, uint32_t addr
     fp = NULL;
 #endif
 
+#if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
+    record_states(context, address, 1, &data);
+#endif
+
     CMDBUF_OFFSET(*context) += 8;
 
     return VG_LITE_SUCCESS;
@@ -1852,7 +1899,7 @@ static vg_lite_error_t push_call(vg_lite_context_t * context, uint32_t address,
 {
     vg_lite_error_t error;
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
-    uint32_t command_id, index;
+    uint32_t command_id;
 #endif
     if (!has_valid_command_buffer(context))
         return VG_LITE_NO_CONTEXT;
@@ -1864,38 +1911,12 @@ static vg_lite_error_t push_call(vg_lite_context_t * context, uint32_t address,
 
     /* Reserve enough space in the command buffer for flush and submit */
     if (CMDBUF_OFFSET(*context) + 56 >= CMDBUF_SIZE(*context)) {
-        uint32_t cmd_count = 0,start_offset = 0;
-        context->end_offset = CMDBUF_OFFSET(*context);
-        start_offset = context->start_offset;
-        VG_LITE_RETURN_ERROR(flush(context));
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);
-        command_id = CMDBUF_INDEX(*context);
-
-        if(CMDBUF_IN_QUEUE(&context->context, command_id))
-            VG_LITE_RETURN_ERROR(stall(context, 0));
-
-        RESERVE_BYTES_IN_CMDBUF(*context);
-
-        if(context->ts_init){
-            memcpy(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context), context->ts_record, 80);
-            CMDBUF_OFFSET(*context) += 80;
-        }
-
-        /* update start offset */
-        context->start_offset = CMDBUF_OFFSET(*context);
-
-        index = (command_id? 0 : 1);
-        command_buffer_copy((void *)(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)), (void *)(context->command_buffer[index] + start_offset),
-                start_offset, context->end_offset, &cmd_count);
-        CMDBUF_OFFSET(*context) += cmd_count;
+        VG_LITE_RETURN_ERROR(rollover(context));
+    }
 #else
     /* Reserve enough space in the command buffer for flush and submit */
-    if (CMDBUF_OFFSET(*context) + 16 >= CMDBUF_SIZE(*context)) {
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);
+    VG_LITE_RETURN_ERROR(reserve_commands(context, 16));
 #endif
-    }
 
     ((uint32_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)))[0] = VG_LITE_CALL((bytes + 7) / 8);
     ((uint32_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)))[1] = address;
@@ -1927,7 +1948,7 @@ static vg_lite_error_t push_rectangle(vg_lite_context_t * context, int x, int y,
 {
     vg_lite_error_t error;
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
-    uint32_t command_id, index;
+    uint32_t command_id;
 #endif
     
     if (!has_valid_command_buffer(context))
@@ -1940,38 +1961,12 @@ static vg_lite_error_t push_rectangle(vg_lite_context_t * context, int x, int y,
 
     /* Reserve enough space in the command buffer for flush and submit */
     if (CMDBUF_OFFSET(*context) + 56 >= CMDBUF_SIZE(*context)) {
-        uint32_t cmd_count = 0,start_offset = 0;
-        context->end_offset = CMDBUF_OFFSET(*context);
-        start_offset = context->start_offset;
-        VG_LITE_RETURN_ERROR(flush(context));
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);
-        command_id = CMDBUF_INDEX(*context);
-
-        if(CMDBUF_IN_QUEUE(&context->context, command_id))
-            VG_LITE_RETURN_ERROR(stall(context, 0));
-
-        RESERVE_BYTES_IN_CMDBUF(*context);
-
-        if(context->ts_init){
-            memcpy(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context), context->ts_record, 80);
-            CMDBUF_OFFSET(*context) += 80;
-        }
-
-        /* update start offset */
-        context->start_offset = CMDBUF_OFFSET(*context);
-
-        index = (command_id? 0 : 1);
-        command_buffer_copy((void *)(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)), (void *)(context->command_buffer[index] + start_offset),
-               start_offset, context->end_offset, &cmd_count);
-        CMDBUF_OFFSET(*context) += cmd_count;
+        VG_LITE_RETURN_ERROR(rollover(context));
+    }
 #else
     /* Reserve enough space in the command buffer for flush and submit */
-    if (CMDBUF_OFFSET(*context) + 16 >= CMDBUF_SIZE(*context)) {
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);
+    VG_LITE_RETURN_ERROR(reserve_commands(context, 16));
 #endif
-    }
 
     ((uint32_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)))[0] = VG_LITE_DATA(1);
     ((uint32_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)))[1] = 0;
@@ -2013,7 +2008,7 @@ static vg_lite_error_t push_data(vg_lite_context_t * context, int size, void * d
 {
     vg_lite_error_t error;
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
-    uint32_t command_id, index;
+    uint32_t command_id;
 #endif
     int bytes = VG_LITE_ALIGN(size, 8);
 
@@ -2027,37 +2022,12 @@ static vg_lite_error_t push_data(vg_lite_context_t * context, int size, void * d
 
     /* Reserve enough space in the command buffer for flush and submit */
     if (CMDBUF_OFFSET(*context) + 48 + bytes >= CMDBUF_SIZE(*context)) {
-        uint32_t cmd_count = 0,start_offset = 0;
-        context->end_offset = CMDBUF_OFFSET(*context);
-        start_offset = context->start_offset;
-        VG_LITE_RETURN_ERROR(flush(context));
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);
-        command_id = CMDBUF_INDEX(*context);
-
-        if(CMDBUF_IN_QUEUE(&context->context, command_id))
-            VG_LITE_RETURN_ERROR(stall(context, 0));
-
-        RESERVE_BYTES_IN_CMDBUF(*context);
-
-        if(context->ts_init){
-            memcpy(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context), context->ts_record, 80);
-            CMDBUF_OFFSET(*context) += 80;
-        }
-
-        /* update start offset */
-        context->start_offset = CMDBUF_OFFSET(*context);
-        index = (command_id? 0 : 1);
-        command_buffer_copy((void *)(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)), (void *)(context->command_buffer[index] + start_offset),
-                start_offset, context->end_offset, &cmd_count);
-        CMDBUF_OFFSET(*context) += cmd_count;
+        VG_LITE_RETURN_ERROR(rollover(context));
+    }
 #else
     /* Reserve enough space in the command buffer for flush and submit */
-    if (CMDBUF_OFFSET(*context) + 8 + bytes >= CMDBUF_SIZE(*context)) {
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);	
+    VG_LITE_RETURN_ERROR(reserve_commands(context, 8 + bytes));
 #endif
-    }
 
     ((uint64_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)))[(bytes / 8)] = 0;
     ((uint32_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)))[0] = VG_LITE_DATA(bytes / 8);
@@ -2100,7 +2070,7 @@ static vg_lite_error_t push_stall(vg_lite_context_t * context, uint32_t module)
 {
     vg_lite_error_t error;
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
-    uint32_t command_id, index;
+    uint32_t command_id;
 #endif
     
     if (!has_valid_command_buffer(context))
@@ -2113,38 +2083,12 @@ static vg_lite_error_t push_stall(vg_lite_context_t * context, uint32_t module)
 
     /* Reserve enough space in the command buffer for flush and submit */
     if (CMDBUF_OFFSET(*context) + 56 >= CMDBUF_SIZE(*context)) {
-        uint32_t cmd_count = 0,start_offset = 0;
-        context->end_offset = CMDBUF_OFFSET(*context);
-        start_offset = context->start_offset;
-        VG_LITE_RETURN_ERROR(flush(context));
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);
-        command_id = CMDBUF_INDEX(*context);
-
-        if(CMDBUF_IN_QUEUE(&context->context, command_id))
-            VG_LITE_RETURN_ERROR(stall(context, 0));
-
-        RESERVE_BYTES_IN_CMDBUF(*context);
-
-        if(context->ts_init){
-            memcpy(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context), context->ts_record, 80);
-            CMDBUF_OFFSET(*context) += 80;
-        }
-
-        /* update start offset */
-        context->start_offset = CMDBUF_OFFSET(*context);
-
-        index = (command_id? 0 : 1);
-        command_buffer_copy((void *)(CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)), (void *)(context->command_buffer[index] + start_offset),
-                start_offset, context->end_offset, &cmd_count);
-        CMDBUF_OFFSET(*context) += cmd_count;
+        VG_LITE_RETURN_ERROR(rollover(context));
+    }
 #else
     /* Reserve enough space in the command buffer for flush and submit */
-    if (CMDBUF_OFFSET(*context) + 16 >= CMDBUF_SIZE(*context)) {
-        VG_LITE_RETURN_ERROR(submit(context));
-        CMDBUF_SWAP(*context);
+    VG_LITE_RETURN_ERROR(reserve_commands(context, 16));
 #endif
-    }
 
     ((uint32_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)))[0] = VG_LITE_SEMAPHORE(module);
     ((uint32_t *) (CMDBUF_BUFFER(*context) + CMDBUF_OFFSET(*context)))[1] = 0;
@@ -2270,7 +2214,17 @@ static vg_lite_error_t submit(vg_lite_context_t *context)
     submit.command_size = CMDBUF_OFFSET(*context);
     submit.command_id = CMDBUF_INDEX(*context);
 
-    VG_LITE_RETURN_ERROR(vg_lite_kernel(VG_LITE_SUBMIT, &submit));
+    error = vg_lite_kernel(VG_LITE_SUBMIT, &submit);
+    if (error != VG_LITE_SUCCESS) {
+        /* Keep the commands for a later submit, e.g. after vg_lite_resume,
+         * but not the END. */
+        CMDBUF_OFFSET(*context) -= 8;
+        return error;
+    }
+
+    context->frame_bytes += submit.command_size;
+    if (submit.command_size > context->frame_peak)
+        context->frame_peak = submit.command_size;
 
     vglitemDUMP_BUFFER("command", (unsigned int)CMDBUF_BUFFER(*context),
         submit.context->command_buffer_logical[CMDBUF_INDEX(*context)], 0, submit.command_size);
@@ -2587,14 +2541,23 @@ static vg_lite_error_t fill_fc_target(vg_lite_buffer_t *target, vg_lite_buffer_t
 }
 #endif
 
-/* Update the fast_clear buffer when render target switched. */
+/* Select the fast_clear buffer of the render target when it is switched.
+ * Each recent target keeps its own cache, so the previous target's one is
+ * left to the GPU and no drain is needed. Only recycling the cache of an
+ * older target waits for the GPU. */
 static vg_lite_error_t update_fc_buffer(vg_lite_buffer_t *target)
 {
     int rt_bytes;
+    uint32_t i;
     vg_lite_error_t error = VG_LITE_SUCCESS;
-    vg_lite_context_t *context = GET_CONTEXT();
+    vg_lite_tls_t* tls;
+    vg_lite_buffer_t *fc;
     vg_lite_kernel_allocate_t allocate;
 
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
     do {
         if (target == NULL) {
             error = VG_LITE_INVALID_ARGUMENT;
@@ -2604,26 +2567,44 @@ static vg_lite_error_t update_fc_buffer(vg_lite_buffer_t *target)
         rt_bytes = target->stride * target->height;
         rt_bytes = VG_LITE_ALIGN(rt_bytes, (FC_BIT_TO_BYTES * 8));
         rt_bytes = rt_bytes / FC_BIT_TO_BYTES / 8;
-        /* Only allocate new buffer when the allocated is not big enough. Yes*/
-        if (rt_bytes > context->fcBuffer.stride ) {
-            vg_lite_free(&context->fcBuffer);
-
-            context->fcBuffer.width = rt_bytes;         /* The actually used bytes. */
-            rt_bytes = VG_LITE_ALIGN(rt_bytes, FC_BURST_BYTES);     /* The allocated aligned bytes. */
-            context->fcBuffer.stride = rt_bytes;
-            allocate.bytes = rt_bytes;
-            allocate.contiguous = 1;
-
-            VG_LITE_BREAK_ERROR(vg_lite_kernel(VG_LITE_ALLOCATE, &allocate));
-            context->fcBuffer.handle = allocate.memory_handle;
-            context->fcBuffer.memory = allocate.memory;
-            context->fcBuffer.address = allocate.memory_gpu;
+
+        for (i = 0; i < FC_TARGET_COUNT; i++) {
+            if (tls->t_context.fcTarget[i] == target && tls->t_context.fcBuffer[i].width == rt_bytes)
+                break;
         }
-        else {
-            /* Just update the fc buffer size. */
-            context->fcBuffer.width = rt_bytes;
+
+        if (i == FC_TARGET_COUNT) {
+            i = tls->t_context.fcNext;
+            tls->t_context.fcNext = (i + 1) % FC_TARGET_COUNT;
+            fc = &tls->t_context.fcBuffer[i];
+
+            /* The GPU may still use the cache of the older target. */
+            if (tls->t_context.fcTarget[i] != NULL)
+                VG_LITE_BREAK_ERROR(vg_lite_finish());
+
+            /* Only allocate new buffer when the allocated is not big enough. */
+            if (rt_bytes > fc->stride) {
+                vg_lite_free(fc);
+
+                allocate.bytes = VG_LITE_ALIGN(rt_bytes, FC_BURST_BYTES);  /* The allocated aligned bytes. */
+                allocate.contiguous = 1;
+
+                VG_LITE_BREAK_ERROR(vg_lite_kernel(VG_LITE_ALLOCATE, &allocate));
+                fc->stride = allocate.bytes;
+                fc->handle = allocate.memory_handle;
+                fc->memory = allocate.memory;
+                fc->address = allocate.memory_gpu;
+            }
+            fc->width = rt_bytes;         /* The actually used bytes. */
+            memset(fc->memory, 0xff, fc->stride);
+            tls->t_context.fcTarget[i] = target;
+            tls->t_context.fcClearValue[i] = 0;
         }
-        memset(context->fcBuffer.memory, 0xff, context->fcBuffer.stride);
+
+        /* A kept cache may hold tiles cleared with its own value. */
+        tls->t_context.fcCurrent = i;
+        VG_LITE_BREAK_ERROR(push_state(&tls->t_context, 0x0A9A, tls->t_context.fcBuffer[i].address));   /* FC buffer address. */
+        VG_LITE_BREAK_ERROR(push_state(&tls->t_context, 0x0A9B, tls->t_context.fcClearValue[i]));      /* FC clear value. */
     } while (0);
 
     return error;
@@ -2633,11 +2614,20 @@ static vg_lite_error_t update_fc_buffer(vg_lite_buffer_t *target)
 static vg_lite_error_t clear_fc(uint32_t value)
 {
     vg_lite_error_t error = VG_LITE_SUCCESS;
-    vg_lite_context_t *context = GET_CONTEXT();
-    uint32_t bytes_to_clear = context->fcBuffer.stride / FC_BURST_BYTES;
+    vg_lite_context_t *context;
+    vg_lite_tls_t* tls;
+    uint32_t bytes_to_clear;
+
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    context = &tls->t_context;
+    bytes_to_clear = FC_BUFFER(*context).stride / FC_BURST_BYTES;
 
     do {
-        VG_LITE_BREAK_ERROR(push_state(context, 0x0A9A, context->fcBuffer.address));   /* FC buffer address. */
+        context->fcClearValue[context->fcCurrent] = value;
+        VG_LITE_BREAK_ERROR(push_state(context, 0x0A9A, FC_BUFFER(*context).address));   /* FC buffer address. */
         VG_LITE_BREAK_ERROR(push_state(context, 0x0A9B, value));                       /* FC clear value. */
         VG_LITE_BREAK_ERROR(push_state(context, 0x0AB0, 0x80000000 | bytes_to_clear));   /* FC clear command. */
     } while (0);
@@ -2754,7 +2744,10 @@ static vg_lite_error_t set_render_target(vg_lite_buffer_t *target)
           return VG_LITE_NO_CONTEXT;   
     }
 
-    tls->t_context.start_offset = CMDBUF_OFFSET(tls->t_context);
+#if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
+    /* Each draw sets all its states from here, only those need restoring. */
+    memset(tls->t_context.state_dirty, 0, sizeof(tls->t_context.state_dirty));
+#endif
 
     if ((target != NULL) &&
         (target->format == VG_LITE_YUY2 ||
@@ -2766,11 +2759,20 @@ static vg_lite_error_t set_render_target(vg_lite_buffer_t *target)
     }
 
 #if VG_TARGET_FAST_CLEAR
-    /* Flush target if necessary when switching. */
-    if (tls->t_context.rtbuffer != NULL) {    /* If it's not the first time to set target. */
-        vg_lite_finish();
+    /* Only switching the target changes the fast clear cache. */
+    if (tls->t_context.rtbuffer != target) {
+        if (tls->t_context.rtbuffer != NULL) {    /* If it's not the first time to set target. */
+#if VG_TARGET_FC_DUMP
+            /* The SW FC decoder resolves the previous target on the CPU. */
+            VG_LITE_RETURN_ERROR(vg_lite_finish());
+#else
+            /* Let the GPU finish writing the previous target before the next
+             * one is drawn, without waiting for it here. */
+            VG_LITE_RETURN_ERROR(flush_target());
+#endif
+        }
+        VG_LITE_RETURN_ERROR(update_fc_buffer(target));
     }
-    update_fc_buffer(target);
 #endif
 
     tiled = (target->tiled != VG_LITE_LINEAR) ? 0x10000000 : 0;
@@ -3114,6 +3116,218 @@ vg_lite_error_t vg_lite_get_transform_matrix(vg_lite_point4_t src, vg_lite_point
     return VG_LITE_SUCCESS;
 }
 
+/* Add a dependency between two passes unless it is already known. */
+static void graph_add_edge(vg_lite_graph_t *graph, uint32_t from, uint32_t to)
+{
+    uint32_t i;
+
+    if (from == to)
+        return;
+
+    for (i = 0; i < graph->edge_count; i++) {
+        if (graph->edges[i][0] == from && graph->edges[i][1] == to)
+            return;
+    }
+
+    graph->edges[graph->edge_count][0] = (uint8_t)from;
+    graph->edges[graph->edge_count][1] = (uint8_t)to;
+    graph->edge_count++;
+}
+
+/* Latest pass rendering to the buffer, or -1. */
+static int32_t graph_find_pass(vg_lite_graph_t *graph, vg_lite_buffer_t *buffer)
+{
+    int32_t i;
+
+    for (i = (int32_t)graph->pass_count - 1; i >= 0; i--) {
+        if (graph->passes[i].target == buffer)
+            return i;
+    }
+
+    return -1;
+}
+
+static vg_lite_error_t graph_replay(vg_lite_context_t *context, vg_lite_op_t *op)
+{
+    vg_lite_matrix_t *matrix0 = op->has_matrix[0] ? &op->matrix[0] : NULL;
+    vg_lite_matrix_t *matrix1 = op->has_matrix[1] ? &op->matrix[1] : NULL;
+
+    context->scissor_enabled = op->scissor_enabled;
+    memcpy(context->scissor, op->scissor, sizeof(context->scissor));
+    context->premultiply_enabled = op->premultiply_enabled;
+
+    switch (op->type) {
+    case VG_LITE_OP_CLEAR:
+        return vg_lite_clear(op->target, op->has_rect ? &op->rectangle : NULL, op->color);
+
+    case VG_LITE_OP_BLIT:
+        return vg_lite_blit(op->target, op->source, matrix0, op->blend, op->color, op->filter);
+
+    case VG_LITE_OP_BLIT_RECT:
+        return vg_lite_blit_rect(op->target, op->source, op->rect, matrix0, op->blend, op->color, op->filter);
+
+    case VG_LITE_OP_DRAW:
+        return vg_lite_draw(op->target, op->path, op->fill_rule, matrix0, op->blend, op->color);
+
+    case VG_LITE_OP_PATTERN:
+        return vg_lite_draw_pattern(op->target, op->path, op->fill_rule, matrix0, op->source, matrix1,
+                                    op->blend, op->pattern_mode, op->color, op->filter);
+
+    case VG_LITE_OP_RADIAL:
+        return vg_lite_draw_radial_gradient(op->target, op->path, op->fill_rule, matrix0, op->grad,
+                                            op->color, op->blend, op->filter);
+    }
+
+    return VG_LITE_INVALID_ARGUMENT;
+}
+
+/* Replay the recorded passes in dependency order and empty the graph.
+ * Among the ready passes the one rendering to the current target goes first,
+ * so each target is bound once per run instead of once per interleaved draw.
+ */
+static vg_lite_error_t graph_execute(vg_lite_context_t *context)
+{
+    vg_lite_error_t error = VG_LITE_SUCCESS;
+    vg_lite_graph_t *graph = &context->graph;
+    uint8_t indegree[GRAPH_MAX_PASSES] = {0};
+    uint8_t done[GRAPH_MAX_PASSES] = {0};
+    vg_lite_buffer_t *current = context->rtbuffer;
+    uint32_t scissor_enabled = context->scissor_enabled;
+    uint32_t premultiply_enabled = context->premultiply_enabled;
+    int32_t scissor[4];
+    int32_t i, n, pick, op;
+
+    if (graph->ops == NULL || graph->replaying || graph->op_count == 0)
+        return VG_LITE_SUCCESS;
+
+    memcpy(scissor, context->scissor, sizeof(scissor));
+    for (i = 0; i < (int32_t)graph->edge_count; i++)
+        indegree[graph->edges[i][1]]++;
+
+    graph->replaying = 1;
+    for (n = 0; n < (int32_t)graph->pass_count && error == VG_LITE_SUCCESS; n++) {
+        pick = -1;
+        for (i = 0; i < (int32_t)graph->pass_count; i++) {
+            if (done[i] || indegree[i])
+                continue;
+            if (pick < 0)
+                pick = i;
+            if (graph->passes[i].target == current) {
+                pick = i;
+                break;
+            }
+        }
+
+        /* Recording keeps the graph acyclic, a pass is always ready. */
+        done[pick] = 1;
+        current = graph->passes[pick].target;
+        for (op = graph->passes[pick].first; op >= 0 && error == VG_LITE_SUCCESS; op = graph->ops[op].next)
+            error = graph_replay(context, &graph->ops[op]);
+
+        for (i = 0; i < (int32_t)graph->edge_count; i++) {
+            if (graph->edges[i][0] == pick)
+                indegree[graph->edges[i][1]]--;
+        }
+    }
+    graph->replaying = 0;
+
+    context->scissor_enabled = scissor_enabled;
+    memcpy(context->scissor, scissor, sizeof(scissor));
+    context->premultiply_enabled = premultiply_enabled;
+
+    graph->op_count = 0;
+    graph->pass_count = 0;
+    graph->edge_count = 0;
+
+    return error;
+}
+
+/* Record an op into the pass of its target.
+ * A pass stops taking ops once it has successors: the target gets a new pass
+ * ordered after the old one and after every recorded pass reading the buffer,
+ * whether or not it was rendered in the graph. Edges therefore only ever
+ * point into open passes and the graph stays acyclic.
+ */
+static vg_lite_error_t graph_add_op(vg_lite_context_t *context,
+                                    vg_lite_op_type_t type,
+                                    vg_lite_buffer_t *target,
+                                    vg_lite_buffer_t *source,
+                                    vg_lite_matrix_t *matrix0,
+                                    vg_lite_matrix_t *matrix1,
+                                    vg_lite_op_t **result)
+{
+    vg_lite_error_t error;
+    vg_lite_graph_t *graph = &context->graph;
+    vg_lite_op_t *op;
+    int32_t pass, prev, written, reader, k;
+
+    /* A new pass adds at most one edge per existing pass plus two. */
+    if (graph->op_count == GRAPH_MAX_OPS ||
+        graph->pass_count == GRAPH_MAX_PASSES ||
+        graph->edge_count + graph->pass_count + 2 > GRAPH_MAX_EDGES)
+        VG_LITE_RETURN_ERROR(graph_execute(context));
+
+    pass = prev = graph_find_pass(graph, target);
+    if (pass < 0 || graph->passes[pass].sealed) {
+        pass = (int32_t)graph->pass_count++;
+        graph->passes[pass].target = target;
+        graph->passes[pass].first = -1;
+        graph->passes[pass].last = -1;
+        graph->passes[pass].sealed = 0;
+
+        if (prev >= 0)
+            graph_add_edge(graph, prev, pass);
+
+        /* Write after read: the readers of the current contents go first. */
+        for (reader = 0; reader < pass; reader++) {
+            for (k = graph->passes[reader].first; k >= 0; k = graph->ops[k].next) {
+                if (graph->ops[k].source == target) {
+                    graph_add_edge(graph, reader, pass);
+                    graph->passes[reader].sealed = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    /* Reading a buffer rendered in the graph orders its pass first. */
+    if (source != NULL && source != target) {
+        written = graph_find_pass(graph, source);
+        if (written >= 0) {
+            graph_add_edge(graph, written, pass);
+            graph->passes[written].sealed = 1;
+        }
+    }
+
+    op = &graph->ops[graph->op_count];
+    memset(op, 0, sizeof(*op));
+    op->type = type;
+    op->target = target;
+    op->source = source;
+    if (matrix0 != NULL) {
+        op->matrix[0] = *matrix0;
+        op->has_matrix[0] = 1;
+    }
+    if (matrix1 != NULL) {
+        op->matrix[1] = *matrix1;
+        op->has_matrix[1] = 1;
+    }
+    op->scissor_enabled = context->scissor_enabled;
+    memcpy(op->scissor, context->scissor, sizeof(op->scissor));
+    op->premultiply_enabled = context->premultiply_enabled;
+    op->next = -1;
+
+    if (graph->passes[pass].last >= 0)
+        graph->ops[graph->passes[pass].last].next = (int32_t)graph->op_count;
+    else
+        graph->passes[pass].first = (int32_t)graph->op_count;
+    graph->passes[pass].last = (int32_t)graph->op_count;
+    graph->op_count++;
+
+    *result = op;
+    return VG_LITE_SUCCESS;
+}
+
 vg_lite_error_t vg_lite_clear(vg_lite_buffer_t * target,
                               vg_lite_rectangle_t * rectangle,
                               vg_lite_color_t color)
@@ -3127,6 +3341,17 @@ vg_lite_error_t vg_lite_clear(vg_lite_buffer_t * target,
     if(tls == NULL)
         return VG_LITE_NO_CONTEXT;
 
+    if (GRAPH_RECORDING(tls->t_context)) {
+        vg_lite_op_t *op;
+        VG_LITE_RETURN_ERROR(graph_add_op(&tls->t_context, VG_LITE_OP_CLEAR, target, NULL, NULL, NULL, &op));
+        if (rectangle != NULL) {
+            op->rectangle = *rectangle;
+            op->has_rect = 1;
+        }
+        op->color = color;
+        return VG_LITE_SUCCESS;
+    }
+
     error = set_render_target(target);
     if (error != VG_LITE_SUCCESS) {
         return error;
@@ -3234,6 +3459,15 @@ vg_lite_error_t vg_lite_blit(vg_lite_buffer_t * target,
     if(tls == NULL)
         return VG_LITE_NO_CONTEXT;
 
+    if (GRAPH_RECORDING(tls->t_context)) {
+        vg_lite_op_t *op;
+        VG_LITE_RETURN_ERROR(graph_add_op(&tls->t_context, VG_LITE_OP_BLIT, target, source, matrix, NULL, &op));
+        op->blend = blend;
+        op->color = color;
+        op->filter = filter;
+        return VG_LITE_SUCCESS;
+    }
+
     /* Calculate bounding box */
     memset(&src_bbx, 0, sizeof(vg_lite_rectangle_t));
     memset(&clip, 0, sizeof(vg_lite_rectangle_t));
@@ -3434,6 +3668,16 @@ vg_lite_error_t vg_lite_blit_rect(vg_lite_buffer_t * target,
     if(tls == NULL)
         return VG_LITE_NO_CONTEXT;
 
+    if (GRAPH_RECORDING(tls->t_context)) {
+        vg_lite_op_t *op;
+        VG_LITE_RETURN_ERROR(graph_add_op(&tls->t_context, VG_LITE_OP_BLIT_RECT, target, source, matrix, NULL, &op));
+        memcpy(op->rect, rect, sizeof(op->rect));
+        op->blend = blend;
+        op->color = color;
+        op->filter = filter;
+        return VG_LITE_SUCCESS;
+    }
+
     error = set_render_target(target);
     if (error != VG_LITE_SUCCESS) {
         return error;
@@ -3662,12 +3906,64 @@ static vg_lite_error_t program_tessellation(vg_lite_context_t *context)
     return error;
 }
 
-vg_lite_error_t vg_lite_init(int32_t tessellation_width,
+static void set_tsbuffer(vg_lite_context_t *context, vg_lite_kernel_initialize_t *initialize)
+{
+    context->tsbuffer.tessellation_buffer_gpu[0] = initialize->tessellation_buffer_gpu[0];
+    context->tsbuffer.tessellation_buffer_gpu[1] = initialize->tessellation_buffer_gpu[1];
+    context->tsbuffer.tessellation_buffer_gpu[2] = initialize->tessellation_buffer_gpu[2];
+    context->tsbuffer.tessellation_buffer_logic[0] = initialize->tessellation_buffer_logic[0];
+    context->tsbuffer.tessellation_buffer_logic[1] = initialize->tessellation_buffer_logic[1];
+    context->tsbuffer.tessellation_buffer_logic[2] = initialize->tessellation_buffer_logic[2];
+    context->tsbuffer.tessellation_stride = initialize->tessellation_stride;
+    context->tsbuffer.tessellation_width_height = initialize->tessellation_width_height;
+    context->tsbuffer.tessellation_buffer_size[0] = initialize->tessellation_buffer_size[0];
+    context->tsbuffer.tessellation_buffer_size[1] = initialize->tessellation_buffer_size[1];
+    context->tsbuffer.tessellation_buffer_size[2] = initialize->tessellation_buffer_size[2];
+    context->tsbuffer.tessellation_shift          = initialize->tessellation_shift;
+}
+
+/* Replace the tessellation buffer, the GPU must be done with the old one. */
+static vg_lite_error_t resize_tessellation(vg_lite_context_t *context, int32_t width, int32_t height)
+{
+    vg_lite_error_t error;
+    vg_lite_kernel_initialize_t initialize;
+
+    memset(&initialize, 0, sizeof(initialize));
+    initialize.context = &context->context;
+    initialize.tessellation_width = VG_LITE_ALIGN(width, 16);
+    initialize.tessellation_height = height;
+    error = vg_lite_kernel(VG_LITE_RESIZE_TESSELLATION, &initialize);
+
+    /* Without memory for the new window the kernel falls back to the old
+     * size, the buffer may still have moved. */
+    if (initialize.tessellation_width_height == 0) {
+        if (error == VG_LITE_OUT_OF_MEMORY) {
+            /* None at all: draws fail until a window is allocated, and the
+             * states of the freed buffer are no longer replayed. */
+            memset(&context->tsbuffer, 0, sizeof(context->tsbuffer));
+#if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
+            context->ts_init = 0;
+#endif
+        }
+        return error;
+    }
+
+    context->capabilities.cap.tiled = initialize.capabilities.cap.tiled;
+    set_tsbuffer(context, &initialize);
+    VG_LITE_RETURN_ERROR(program_tessellation(context));
+
+    return error;
+}
+
+vg_lite_error_t vg_lite_init(int32_t tessellation_width,
                              int32_t tessellation_height)
 {
     vg_lite_error_t error;
     vg_lite_kernel_initialize_t initialize;
     vg_lite_tls_t* task_tls;
+#if VG_TARGET_FAST_CLEAR
+    uint32_t i;
+#endif
 
     task_tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
     if(task_tls)
@@ -3704,6 +4000,7 @@ vg_lite_error_t vg_lite_init(int32_t tessellation_width,
     task_tls->t_context.command_buffer[0] = (uint8_t *)initialize.command_buffer[0];
     task_tls->t_context.command_buffer[1] = (uint8_t *)initialize.command_buffer[1];
     task_tls->t_context.command_buffer_size = initialize.command_buffer_size;
+    task_tls->t_context.cmdbuf_stats.size = initialize.command_buffer_size;
     task_tls->t_context.command_offset[0] = 0;
     task_tls->t_context.command_offset[1] = 0;
     task_tls->t_context.command_buffer_current = 0;
@@ -3712,28 +4009,16 @@ vg_lite_error_t vg_lite_init(int32_t tessellation_width,
     task_tls->t_context.context_buffer_size = initialize.context_buffer_size;
     task_tls->t_context.context_buffer_offset[0] = 0;
     task_tls->t_context.context_buffer_offset[1] = 0;
-    task_tls->t_context.start_offset = 0;
-    task_tls->t_context.end_offset = 0;
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
     task_tls->t_context.ts_init = 0;
     memset(task_tls->t_context.ts_record, 0, sizeof(task_tls->t_context.ts_record));
+    memset(task_tls->t_context.state_dirty, 0, sizeof(task_tls->t_context.state_dirty));
 #endif
     if ((tessellation_width  > 0) &&
         (tessellation_height > 0))
     {
         /* Set and Program Tessellation Buffer states. */
-        task_tls->t_context.tsbuffer.tessellation_buffer_gpu[0] = initialize.tessellation_buffer_gpu[0];
-        task_tls->t_context.tsbuffer.tessellation_buffer_gpu[1] = initialize.tessellation_buffer_gpu[1];
-        task_tls->t_context.tsbuffer.tessellation_buffer_gpu[2] = initialize.tessellation_buffer_gpu[2];
-        task_tls->t_context.tsbuffer.tessellation_buffer_logic[0] = initialize.tessellation_buffer_logic[0];
-        task_tls->t_context.tsbuffer.tessellation_buffer_logic[1] = initialize.tessellation_buffer_logic[1];
-        task_tls->t_context.tsbuffer.tessellation_buffer_logic[2] = initialize.tessellation_buffer_logic[2];
-        task_tls->t_context.tsbuffer.tessellation_stride = initialize.tessellation_stride;
-        task_tls->t_context.tsbuffer.tessellation_width_height = initialize.tessellation_width_height;
-        task_tls->t_context.tsbuffer.tessellation_buffer_size[0] = initialize.tessellation_buffer_size[0];
-        task_tls->t_context.tsbuffer.tessellation_buffer_size[1] = initialize.tessellation_buffer_size[1];
-        task_tls->t_context.tsbuffer.tessellation_buffer_size[2] = initialize.tessellation_buffer_size[2];
-        task_tls->t_context.tsbuffer.tessellation_shift          = initialize.tessellation_shift;
+        set_tsbuffer(&task_tls->t_context, &initialize);
 
         VG_LITE_RETURN_ERROR(program_tessellation(&task_tls->t_context));
     }
@@ -3747,10 +4032,16 @@ vg_lite_error_t vg_lite_init(int32_t tessellation_width,
     VG_LITE_RETURN_ERROR(vg_lite_kernel(VG_LITE_UNLOCK, NULL));
 
 #if VG_TARGET_FAST_CLEAR
-    /* Reset the FAST_CLEAR buffer. */
-    memset(&task_tls->t_context.fcBuffer, 0, sizeof(task_tls->t_context.fcBuffer));
-    task_tls->t_context.fcBuffer.format = VG_LITE_A8;
-    task_tls->t_context.fcBuffer.height = 1;
+    /* Reset the FAST_CLEAR buffers. */
+    memset(task_tls->t_context.fcBuffer, 0, sizeof(task_tls->t_context.fcBuffer));
+    memset(task_tls->t_context.fcTarget, 0, sizeof(task_tls->t_context.fcTarget));
+    memset(task_tls->t_context.fcClearValue, 0, sizeof(task_tls->t_context.fcClearValue));
+    for (i = 0; i < FC_TARGET_COUNT; i++) {
+        task_tls->t_context.fcBuffer[i].format = VG_LITE_A8;
+        task_tls->t_context.fcBuffer[i].height = 1;
+    }
+    task_tls->t_context.fcCurrent = 0;
+    task_tls->t_context.fcNext = 0;
     task_tls->t_context.clearValue = 0;
 #endif
 
@@ -3819,6 +4110,20 @@ vg_lite_error_t vg_lite_draw(vg_lite_buffer_t * target,
     if(tls == NULL)
         return VG_LITE_NO_CONTEXT;
 
+    /* No tessellation window since a resize ran out of memory. */
+    if (tls->t_context.tsbuffer.tessellation_width_height == 0)
+        return VG_LITE_NO_CONTEXT;
+
+    if (GRAPH_RECORDING(tls->t_context)) {
+        vg_lite_op_t *op;
+        VG_LITE_RETURN_ERROR(graph_add_op(&tls->t_context, VG_LITE_OP_DRAW, target, NULL, matrix, NULL, &op));
+        op->path = path;
+        op->fill_rule = fill_rule;
+        op->blend = blend;
+        op->color = color;
+        return VG_LITE_SUCCESS;
+    }
+
     if(!vg_lite_query_feature(gcFEATURE_BIT_VG_QUALITY_8X) && path->quality == VG_LITE_UPPER){
         return VG_LITE_NOT_SUPPORT;
     }
@@ -3847,7 +4152,8 @@ vg_lite_error_t vg_lite_draw(vg_lite_buffer_t * target,
         point_max.y = target->height;
     }
 
-    if (ts_is_fullscreen == 0){
+    /* The auto sizer needs the path box even if the window covers the target. */
+    if (ts_is_fullscreen == 0 || tls->t_context.ts_budget != 0){
         transform(&temp, (vg_lite_float_t)path->bounding_box[0], (vg_lite_float_t)path->bounding_box[1], matrix);
         point_min = point_max = temp;
 
@@ -3880,6 +4186,11 @@ vg_lite_error_t vg_lite_draw(vg_lite_buffer_t * target,
             point_max.x = MIN(point_max.x, tls->t_context.scissor[0] + tls->t_context.scissor[2]);
             point_max.y = MIN(point_max.y, tls->t_context.scissor[1] + tls->t_context.scissor[3]);
         }
+
+        if (tls->t_context.ts_budget != 0) {
+            tls->t_context.ts_box_width = MAX(tls->t_context.ts_box_width, point_max.x - point_min.x);
+            tls->t_context.ts_box_height = MAX(tls->t_context.ts_box_height, point_max.y - point_min.y);
+        }
     }
 
     /* Convert states into hardware values. */
@@ -3986,14 +4297,25 @@ vg_lite_error_t vg_lite_close(void)
     vg_lite_error_t error;
     vg_lite_kernel_terminate_t terminate;
     vg_lite_tls_t* tls;
+#if VG_TARGET_FAST_CLEAR
+    uint32_t i;
+#endif
 
     tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
     if(tls == NULL)
         return VG_LITE_NO_CONTEXT;
 
+    /* Pending deferred draws are dropped. */
+    if (tls->t_context.graph.ops != NULL) {
+        vg_lite_os_free(tls->t_context.graph.ops);
+        tls->t_context.graph.ops = NULL;
+    }
+
 #if VG_TARGET_FAST_CLEAR
-    if (tls->t_context.fcBuffer.handle != NULL) {
-        vg_lite_free(&tls->t_context.fcBuffer);
+    for (i = 0; i < FC_TARGET_COUNT; i++) {
+        if (tls->t_context.fcBuffer[i].handle != NULL) {
+            vg_lite_free(&tls->t_context.fcBuffer[i]);
+        }
     }
 #endif
 
@@ -4020,6 +4342,48 @@ vg_lite_error_t vg_lite_close(void)
     return VG_LITE_SUCCESS;
 }
 
+vg_lite_error_t vg_lite_suspend(void)
+{
+    vg_lite_error_t error;
+    vg_lite_tls_t* tls;
+
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    VG_LITE_RETURN_ERROR(vg_lite_finish());
+
+    return vg_lite_kernel(VG_LITE_SUSPEND, NULL);
+}
+
+vg_lite_error_t vg_lite_resume(void)
+{
+    vg_lite_error_t error;
+    vg_lite_tls_t* tls;
+    uint32_t i;
+
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    VG_LITE_RETURN_ERROR(vg_lite_kernel(VG_LITE_RESUME, NULL));
+
+    /* The GPU lost the states that are only programmed on a change. */
+    for (i = 0; i < 4; i++) {
+        if (tls->t_context.colors[i] != NULL)
+            tls->t_context.clut_dirty[i] = 1;
+    }
+#if VG_TARGET_FAST_CLEAR
+    /* The next draw programs the fast clear cache of its target again. */
+    tls->t_context.rtbuffer = NULL;
+#endif
+
+    if (tls->t_context.tsbuffer.tessellation_width_height != 0)
+        VG_LITE_RETURN_ERROR(program_tessellation(&tls->t_context));
+
+    return VG_LITE_SUCCESS;
+}
+
 /* Handle tiled & yuv allocation. Currently including NV12, ANV12, YV12, YV16, NV16, YV24. */
 static  vg_lite_error_t _allocate_tiled_yuv_planar(vg_lite_buffer_t *buffer)
 {
@@ -4191,11 +4555,17 @@ vg_lite_error_t vg_lite_free(vg_lite_buffer_t * buffer)
     vg_lite_error_t error;
     vg_lite_kernel_free_t free, uv_free, v_free;
     vg_lite_tls_t* tls;
+#if VG_TARGET_FAST_CLEAR
+    uint32_t i;
+#endif
 
     tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
     if(tls == NULL)
         return VG_LITE_NO_CONTEXT;
 
+    /* Deferred draws may still reference the buffer. */
+    VG_LITE_RETURN_ERROR(graph_execute(&tls->t_context));
+
     if(buffer == NULL)
         return VG_LITE_INVALID_ARGUMENT;
     if (tls->t_context.rtbuffer == buffer && !(memcmp(tls->t_context.rtbuffer,buffer,sizeof(vg_lite_buffer_t))) ) {
@@ -4215,6 +4585,14 @@ vg_lite_error_t vg_lite_free(vg_lite_buffer_t * buffer)
         tls->t_context.rtbuffer = NULL;
     }
 
+#if VG_TARGET_FAST_CLEAR
+    /* Its fast clear cache must not follow a new buffer at the same place. */
+    for (i = 0; i < FC_TARGET_COUNT; i++) {
+        if (tls->t_context.fcTarget[i] == buffer)
+            tls->t_context.fcTarget[i] = NULL;
+    }
+#endif
+
     if (buffer->yuv.uv_planar) {
         /* Free UV(U) planar buffer. */
         uv_free.memory_handle = buffer->yuv.uv_handle;
@@ -4374,6 +4752,139 @@ uint32_t vg_lite_query_feature(vg_lite_feature_t feature)
     return result;
 }
 
+/* Bytes the kernel allocates for a tessellation window. */
+static uint32_t tessellation_bytes(vg_lite_context_t *context, int32_t width, int32_t height)
+{
+    uint32_t stride, buffer_size, l1_size, l2_size;
+
+    stride = VG_LITE_TS_STRIDE(VG_LITE_TS_WIDTH(width, context->chip_id));
+    buffer_size = VG_LITE_TS_BUFFER_SIZE(stride, VG_LITE_ALIGN(height, 16));
+    l1_size = VG_LITE_TS_L1_SIZE(buffer_size);
+    l2_size = VG_LITE_TS_L2_SIZE(l1_size, context->capabilities.cap.l2_cache);
+
+    return buffer_size + l1_size + l2_size;
+}
+
+/* Fit the tessellation window to the path boxes of the last frames, within
+ * the budget, so that paths take as few tessellation passes as possible. */
+static vg_lite_error_t auto_size_tessellation(vg_lite_context_t *context)
+{
+    int32_t width = context->ts_box_width;
+    int32_t height = context->ts_box_height;
+    int32_t current_width = context->tsbuffer.tessellation_width_height & 0xFFFF;
+    int32_t current_height = context->tsbuffer.tessellation_width_height >> 16;
+
+    context->ts_box_width = 0;
+    context->ts_box_height = 0;
+    if (context->ts_budget == 0 || width <= 0 || height <= 0)
+        return VG_LITE_SUCCESS;
+
+    /* Grow as soon as a path needs several passes, shrink after a run of small frames. */
+    if (width > current_width || height > current_height) {
+        width = MAX(width, current_width);
+        height = MAX(height, current_height);
+        context->ts_quiet_frames = 0;
+        context->ts_quiet_width = 0;
+        context->ts_quiet_height = 0;
+    }
+    else {
+        context->ts_quiet_width = MAX(context->ts_quiet_width, width);
+        context->ts_quiet_height = MAX(context->ts_quiet_height, height);
+        if (++context->ts_quiet_frames < TS_SHRINK_FRAMES)
+            return VG_LITE_SUCCESS;
+
+        width = context->ts_quiet_width;
+        height = context->ts_quiet_height;
+        context->ts_quiet_frames = 0;
+        context->ts_quiet_width = 0;
+        context->ts_quiet_height = 0;
+        if (width * height * 2 > current_width * current_height)
+            return VG_LITE_SUCCESS;
+    }
+
+    width = VG_LITE_ALIGN(width, 16);
+    height = VG_LITE_ALIGN(height, 16);
+    while (height > 16 && tessellation_bytes(context, width, height) > context->ts_budget)
+        height -= 16;
+    while (width > 16 && tessellation_bytes(context, width, height) > context->ts_budget)
+        width -= 16;
+    if (width == current_width && height == current_height)
+        return VG_LITE_SUCCESS;
+
+#if !defined(ONE_TASK_SUPPORT)
+    /* Try again after the next frame if a buffer is still busy. */
+    if (CMDBUF_IN_QUEUE(&context->context, 0) || CMDBUF_IN_QUEUE(&context->context, 1))
+        return VG_LITE_SUCCESS;
+#endif
+
+    return resize_tessellation(context, width, height);
+}
+
+/* Publish the usage of the frame that just finished and, in auto size mode,
+ * resize the command buffers toward at most one rollover per frame. */
+static vg_lite_error_t end_frame(vg_lite_context_t *context)
+{
+    vg_lite_error_t error;
+    vg_lite_command_buffer_stats_t *stats = &context->cmdbuf_stats;
+    uint32_t size = 0;
+
+    stats->frames++;
+    stats->rollovers = context->frame_rollovers;
+    stats->peak_bytes = context->frame_peak;
+    stats->frame_bytes = context->frame_bytes;
+    stats->total_rollovers += stats->rollovers;
+    stats->max_rollovers = MAX(stats->max_rollovers, stats->rollovers);
+    stats->max_peak_bytes = MAX(stats->max_peak_bytes, stats->peak_bytes);
+    stats->max_frame_bytes = MAX(stats->max_frame_bytes, stats->frame_bytes);
+
+    context->frame_rollovers = 0;
+    context->frame_peak = 0;
+    context->frame_bytes = 0;
+
+    VG_LITE_RETURN_ERROR(auto_size_tessellation(context));
+
+    if (context->cmdbuf_budget == 0)
+        return VG_LITE_SUCCESS;
+
+    /* Two buffers holding half of the frame each roll over once, keep 25% headroom. */
+    if (stats->rollovers > 1) {
+        size = stats->frame_bytes / 2 + stats->frame_bytes / 8;
+        context->quiet_frames = 0;
+        context->quiet_bytes = 0;
+    }
+    else {
+        context->quiet_frames++;
+        context->quiet_bytes = MAX(context->quiet_bytes, stats->frame_bytes);
+        if (context->quiet_frames >= CMDBUF_SHRINK_FRAMES) {
+            size = context->quiet_bytes / 2 + context->quiet_bytes / 8;
+            /* Only shrink to less than half, so the size does not oscillate. */
+            if (size >= CMDBUF_SIZE(*context) / 2)
+                size = 0;
+            context->quiet_frames = 0;
+            context->quiet_bytes = 0;
+        }
+    }
+
+    if (size == 0)
+        return VG_LITE_SUCCESS;
+
+    size = VG_LITE_ALIGN(size, CMDBUF_SIZE_ALIGN);
+    size = CLAMP(size, CMDBUF_MIN_SIZE, MAX(context->cmdbuf_budget / 2, CMDBUF_MIN_SIZE));
+    if (size == CMDBUF_SIZE(*context))
+        return VG_LITE_SUCCESS;
+
+#if !defined(ONE_TASK_SUPPORT)
+    /* Try again after the next frame if a buffer is still busy. */
+    if (CMDBUF_IN_QUEUE(&context->context, 0) || CMDBUF_IN_QUEUE(&context->context, 1))
+        return VG_LITE_SUCCESS;
+#endif
+
+    VG_LITE_RETURN_ERROR(vg_lite_set_command_buffer_size(size));
+    stats->resizes++;
+
+    return VG_LITE_SUCCESS;
+}
+
 vg_lite_error_t vg_lite_finish()
 {
     vg_lite_error_t  error;
@@ -4386,6 +4897,8 @@ vg_lite_error_t vg_lite_finish()
     if(tls == NULL)
         return VG_LITE_NO_CONTEXT;
 
+    VG_LITE_RETURN_ERROR(graph_execute(&tls->t_context));
+
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
     command_id = CMDBUF_INDEX(tls->t_context);
     index = command_id ? 0 : 1;
@@ -4413,7 +4926,12 @@ vg_lite_error_t vg_lite_finish()
         VG_LITE_RETURN_ERROR(vg_lite_kernel(VG_LITE_LOCK, NULL));
         /* if context have been switched and this task need use index. */
         VG_LITE_RETURN_ERROR(update_context_buffer());
-        VG_LITE_RETURN_ERROR(submit(&tls->t_context));
+        error = submit(&tls->t_context);
+        if (error != VG_LITE_SUCCESS) {
+            /* Refused, e.g. while suspended. */
+            vg_lite_kernel(VG_LITE_UNLOCK, NULL);
+            return error;
+        }
         VG_LITE_RETURN_ERROR(vg_lite_kernel(VG_LITE_UNLOCK, NULL));
         VG_LITE_RETURN_ERROR(stall(&tls->t_context, 0));
     }
@@ -4429,7 +4947,7 @@ vg_lite_error_t vg_lite_finish()
     /*Only used in cmodel/fpga. In final SOC this SW FC decoder should be removed. */
     if (tls->t_context.rtbuffer != NULL) {
 #if VG_TARGET_FC_DUMP
-        fc_buf_dump(tls->t_context.rtbuffer, &tls->t_context.fcBuffer);
+        fc_buf_dump(tls->t_context.rtbuffer, &FC_BUFFER(tls->t_context));
 #endif /* VG_TARGET_FC_DUMP */
     }
 #endif
@@ -4457,6 +4975,35 @@ vg_lite_error_t vg_lite_finish()
     return VG_LITE_SUCCESS;
 }
 
+vg_lite_error_t vg_lite_end_frame(void)
+{
+    vg_lite_error_t error;
+    vg_lite_tls_t* tls;
+
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    VG_LITE_RETURN_ERROR(vg_lite_finish());
+
+    return end_frame(&tls->t_context);
+}
+
+vg_lite_error_t vg_lite_barrier(void)
+{
+    vg_lite_error_t error;
+    vg_lite_tls_t* tls;
+
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    /* Recorded draws are not in the command buffer yet. */
+    VG_LITE_RETURN_ERROR(graph_execute(&tls->t_context));
+
+    return flush_target();
+}
+
 vg_lite_error_t vg_lite_flush(void)
 {
     vg_lite_error_t error;
@@ -4467,6 +5014,9 @@ vg_lite_error_t vg_lite_flush(void)
     if(tls == NULL)
         return VG_LITE_NO_CONTEXT;
 
+    /* Replay deferred draws before submitting. */
+    VG_LITE_RETURN_ERROR(graph_execute(&tls->t_context));
+
     /* Return if there is nothing to submit. */
     if (CMDBUF_OFFSET(tls->t_context) == 0)
         return VG_LITE_SUCCESS;
@@ -4478,13 +5028,26 @@ vg_lite_error_t vg_lite_flush(void)
     /* if context have been switched and this task need use index. */
     VG_LITE_RETURN_ERROR(update_context_buffer());
 #endif
-    VG_LITE_RETURN_ERROR(submit(&tls->t_context));
+    error = submit(&tls->t_context);
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
+    if (error != VG_LITE_SUCCESS) {
+        /* Refused, e.g. while suspended. */
+        vg_lite_kernel(VG_LITE_UNLOCK, NULL);
+        return error;
+    }
     VG_LITE_RETURN_ERROR(vg_lite_kernel(VG_LITE_UNLOCK, NULL));
+#else
+    if (error != VG_LITE_SUCCESS)
+        return error;
 #endif
     CMDBUF_SWAP(tls->t_context);
 
+#if !defined(_BAREMETAL)
     VG_LITE_RETURN_ERROR(push_state(&tls->t_context, 0x0A00, 0x0));
+#else
+    /* The swapped in buffer may still be queued on the GPU, the next push
+     * waits for it. Its offset is reset below anyway. */
+#endif
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
     uint32_t id;
     /* Set tessellation buffer states */
@@ -4922,6 +5485,9 @@ vg_lite_error_t vg_lite_set_CLUT(uint32_t count,
     if(tls == NULL)
         return VG_LITE_NO_CONTEXT;
 
+    /* Deferred draws use the CLUT that was current when they were recorded. */
+    VG_LITE_RETURN_ERROR(graph_execute(&tls->t_context));
+
     if(!tls->t_context.s_ftable.ftable[gcFEATURE_BIT_VG_IM_INDEX_FORMAT])
         return VG_LITE_NOT_SUPPORT;
 
@@ -4991,6 +5557,22 @@ vg_lite_error_t vg_lite_draw_pattern(vg_lite_buffer_t * target,
     if(tls == NULL)
         return VG_LITE_NO_CONTEXT;
 
+    /* No tessellation window since a resize ran out of memory. */
+    if (tls->t_context.tsbuffer.tessellation_width_height == 0)
+        return VG_LITE_NO_CONTEXT;
+
+    if (GRAPH_RECORDING(tls->t_context)) {
+        vg_lite_op_t *op;
+        VG_LITE_RETURN_ERROR(graph_add_op(&tls->t_context, VG_LITE_OP_PATTERN, target, source, matrix0, matrix1, &op));
+        op->path = path;
+        op->fill_rule = fill_rule;
+        op->blend = blend;
+        op->pattern_mode = pattern_mode;
+        op->color = pattern_color;
+        op->filter = filter;
+        return VG_LITE_SUCCESS;
+    }
+
     /* The following code is from "draw path" */
     uint32_t format, quality, tiling, fill;
     uint32_t tessellation_size;
@@ -5141,7 +5723,8 @@ vg_lite_error_t vg_lite_draw_pattern(vg_lite_buffer_t * target,
     /* Work on path states. */
     matrix = matrix0;
 
-    if (ts_is_fullscreen == 0){
+    /* The auto sizer needs the path box even if the window covers the target. */
+    if (ts_is_fullscreen == 0 || tls->t_context.ts_budget != 0){
         transform(&temp, (vg_lite_float_t)path->bounding_box[0], (vg_lite_float_t)path->bounding_box[1], matrix);
         point_min = point_max = temp;
 
@@ -5174,6 +5757,11 @@ vg_lite_error_t vg_lite_draw_pattern(vg_lite_buffer_t * target,
             point_max.x = MIN(point_max.x, tls->t_context.scissor[0] + tls->t_context.scissor[2]);
             point_max.y = MIN(point_max.y, tls->t_context.scissor[1] + tls->t_context.scissor[3]);
         }
+
+        if (tls->t_context.ts_budget != 0) {
+            tls->t_context.ts_box_width = MAX(tls->t_context.ts_box_width, point_max.x - point_min.x);
+            tls->t_context.ts_box_height = MAX(tls->t_context.ts_box_height, point_max.y - point_min.y);
+        }
     }
 
     /* Convert states into hardware values. */
@@ -5340,6 +5928,22 @@ vg_lite_error_t vg_lite_draw_radial_gradient(vg_lite_buffer_t * target,
     if(tls == NULL)
         return VG_LITE_NO_CONTEXT;
 
+    /* No tessellation window since a resize ran out of memory. */
+    if (tls->t_context.tsbuffer.tessellation_width_height == 0)
+        return VG_LITE_NO_CONTEXT;
+
+    if (GRAPH_RECORDING(tls->t_context)) {
+        vg_lite_op_t *op;
+        VG_LITE_RETURN_ERROR(graph_add_op(&tls->t_context, VG_LITE_OP_RADIAL, target, NULL, path_matrix, NULL, &op));
+        op->path = path;
+        op->fill_rule = fill_rule;
+        op->grad = grad;
+        op->color = paint_color;
+        op->blend = blend;
+        op->filter = filter;
+        return VG_LITE_SUCCESS;
+    }
+
     if(!vg_lite_query_feature(gcFEATURE_BIT_VG_RADIAL_GRADIENT))
         return VG_LITE_NOT_SUPPORT;
 
@@ -5708,7 +6312,8 @@ vg_lite_error_t vg_lite_draw_radial_gradient(vg_lite_buffer_t * target,
     /* Work on path states. */
     matrix = path_matrix;
 
-    if (ts_is_fullscreen == 0){
+    /* The auto sizer needs the path box even if the window covers the target. */
+    if (ts_is_fullscreen == 0 || tls->t_context.ts_budget != 0){
         transform(&temp, (vg_lite_float_t)path->bounding_box[0], (vg_lite_float_t)path->bounding_box[1], matrix);
         point_min = point_max = temp;
 
@@ -5741,6 +6346,11 @@ vg_lite_error_t vg_lite_draw_radial_gradient(vg_lite_buffer_t * target,
             point_max.x = MIN(point_max.x, tls->t_context.scissor[0] + tls->t_context.scissor[2]);
             point_max.y = MIN(point_max.y, tls->t_context.scissor[1] + tls->t_context.scissor[3]);
         }
+
+        if (tls->t_context.ts_budget != 0) {
+            tls->t_context.ts_box_width = MAX(tls->t_context.ts_box_width, point_max.x - point_min.x);
+            tls->t_context.ts_box_height = MAX(tls->t_context.ts_box_height, point_max.y - point_min.y);
+        }
     }
 
     /* Convert states into hardware values. */
@@ -6343,6 +6953,110 @@ vg_lite_error_t vg_lite_set_command_buffer_size(uint32_t size)
     return error;
 }
 
+vg_lite_error_t vg_lite_set_command_buffer_auto_size(uint32_t budget)
+{
+    vg_lite_tls_t* tls;
+
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    if (budget != 0 && budget < 2 * CMDBUF_MIN_SIZE)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    tls->t_context.cmdbuf_budget = budget;
+    tls->t_context.quiet_frames = 0;
+    tls->t_context.quiet_bytes = 0;
+
+    return VG_LITE_SUCCESS;
+}
+
+vg_lite_error_t vg_lite_set_tessellation_window(int32_t tessellation_width, int32_t tessellation_height)
+{
+    vg_lite_error_t error;
+    vg_lite_tls_t* tls;
+
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    if (tessellation_width <= 0 || tessellation_height <= 0)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    VG_LITE_RETURN_ERROR(vg_lite_finish());
+
+    return resize_tessellation(&tls->t_context, tessellation_width, tessellation_height);
+}
+
+vg_lite_error_t vg_lite_set_tessellation_auto_size(uint32_t budget)
+{
+    vg_lite_tls_t* tls;
+
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    tls->t_context.ts_budget = budget;
+    tls->t_context.ts_box_width = 0;
+    tls->t_context.ts_box_height = 0;
+    tls->t_context.ts_quiet_frames = 0;
+    tls->t_context.ts_quiet_width = 0;
+    tls->t_context.ts_quiet_height = 0;
+
+    return VG_LITE_SUCCESS;
+}
+
+vg_lite_error_t vg_lite_get_command_buffer_stats(vg_lite_command_buffer_stats_t *stats)
+{
+    vg_lite_tls_t* tls;
+
+    if (stats == NULL)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    *stats = tls->t_context.cmdbuf_stats;
+
+    return VG_LITE_SUCCESS;
+}
+
+vg_lite_error_t vg_lite_reset_command_buffer_stats(void)
+{
+    vg_lite_tls_t* tls;
+    uint32_t size;
+
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    size = tls->t_context.cmdbuf_stats.size;
+    memset(&tls->t_context.cmdbuf_stats, 0, sizeof(tls->t_context.cmdbuf_stats));
+    tls->t_context.cmdbuf_stats.size = size;
+
+    return VG_LITE_SUCCESS;
+}
+
+vg_lite_error_t vg_lite_set_context_priority(uint32_t priority)
+{
+#if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
+    vg_lite_tls_t* tls;
+    vg_lite_kernel_priority_t data;
+
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    data.context = &tls->t_context.context;
+    data.priority = priority;
+
+    return vg_lite_kernel(VG_LITE_SET_PRIORITY, &data);
+#else
+    return VG_LITE_NOT_SUPPORT;
+#endif
+}
+
 vg_lite_error_t vg_lite_set_scissor(int32_t x, int32_t y, int32_t width, int32_t height)
 {
     vg_lite_tls_t* tls;
@@ -6389,6 +7103,49 @@ vg_lite_error_t vg_lite_disable_scissor(void)
     return VG_LITE_SUCCESS;
 }
 
+vg_lite_error_t vg_lite_enable_deferred(void)
+{
+    vg_lite_tls_t* tls;
+
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    if (tls->t_context.graph.ops != NULL)
+        return VG_LITE_SUCCESS;
+
+    tls->t_context.graph.ops = (vg_lite_op_t *) vg_lite_os_malloc(GRAPH_MAX_OPS * sizeof(vg_lite_op_t));
+    if (tls->t_context.graph.ops == NULL)
+        return VG_LITE_OUT_OF_MEMORY;
+
+    tls->t_context.graph.op_count = 0;
+    tls->t_context.graph.pass_count = 0;
+    tls->t_context.graph.edge_count = 0;
+    tls->t_context.graph.replaying = 0;
+
+    return VG_LITE_SUCCESS;
+}
+
+vg_lite_error_t vg_lite_disable_deferred(void)
+{
+    vg_lite_error_t error;
+    vg_lite_tls_t* tls;
+
+    tls = (vg_lite_tls_t *) vg_lite_os_get_tls();
+    if(tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    if (tls->t_context.graph.ops == NULL)
+        return VG_LITE_SUCCESS;
+
+    /* Replay what was recorded, then go back to immediate mode. */
+    error = graph_execute(&tls->t_context);
+    vg_lite_os_free(tls->t_context.graph.ops);
+    tls->t_context.graph.ops = NULL;
+
+    return error;
+}
+
 vg_lite_error_t vg_lite_mem_avail(uint32_t *size)
 {
     vg_lite_error_t error = VG_LITE_SUCCESS;
@@ -37,9 +37,141 @@ static int s_reference = 0;
 static int task_num = 0;
 static vg_lite_kernel_initialize_t ts_initialize = {0};
 static uint8_t ts_init = 0;
+static void *ts_buffer = NULL;
+static uint8_t suspended = 0;
 
 static vg_lite_error_t do_terminate(vg_lite_kernel_terminate_t * data);
 
+/* Allocate the tessellation buffer shared by all contexts for the window in
+ * data, and record it in ts_initialize. */
+static vg_lite_error_t allocate_tessellation(vg_lite_kernel_context_t * context, vg_lite_kernel_initialize_t * data)
+{
+    vg_lite_error_t error;
+    unsigned long stride, buffer_size, l1_size, l2_size;
+    int width = VG_LITE_TS_WIDTH(data->tessellation_width, vg_lite_hal_peek(0x20));
+    int height = VG_LITE_ALIGN(data->tessellation_height, 16);
+
+    /* Check if we can used tiled tessellation (128x16). */
+    if (((width & 127) == 0) && ((height & 15) == 0)) {
+        data->capabilities.cap.tiled = 0x3;
+    } else {
+        data->capabilities.cap.tiled = 0x2;
+    }
+
+    /* Compute tessellation buffer size. */
+    stride = VG_LITE_TS_STRIDE(width);
+    buffer_size = VG_LITE_TS_BUFFER_SIZE(stride, height);
+    l1_size = VG_LITE_TS_L1_SIZE(buffer_size);
+    l2_size = VG_LITE_TS_L2_SIZE(l1_size, data->capabilities.cap.l2_cache);
+
+    /* Allocate the memory. */
+    vg_lite_os_lock();
+    error = vg_lite_hal_allocate_contiguous(buffer_size + l1_size + l2_size,
+                                                                   &context->tessellation_buffer_logical,
+                                                                   &context->tessellation_buffer_physical,
+                                                                   &context->tessellation_buffer);
+    vg_lite_os_unlock();
+
+    if (error != VG_LITE_SUCCESS)
+        return error;
+    ts_buffer = context->tessellation_buffer;
+
+    /* Return the tessellation buffer pointers and GPU addresses. */
+    ts_initialize.capabilities = data->capabilities;
+    ts_initialize.tessellation_buffer_gpu[0] = context->tessellation_buffer_physical;
+    ts_initialize.tessellation_buffer_gpu[1] = context->tessellation_buffer_physical + buffer_size;
+    ts_initialize.tessellation_buffer_gpu[2] = (l2_size ? ts_initialize.tessellation_buffer_gpu[1] + l1_size
+                                        : ts_initialize.tessellation_buffer_gpu[1]);
+    ts_initialize.tessellation_buffer_logic[0] = (uint8_t *)context->tessellation_buffer_logical;
+    ts_initialize.tessellation_buffer_logic[1] = ts_initialize.tessellation_buffer_logic[0] + buffer_size;
+    ts_initialize.tessellation_buffer_logic[2] = (l2_size ? ts_initialize.tessellation_buffer_logic[1] + l1_size
+                                          : ts_initialize.tessellation_buffer_logic[1]);
+    ts_initialize.tessellation_buffer_size[0] = buffer_size;
+    ts_initialize.tessellation_buffer_size[1] = l1_size;
+    ts_initialize.tessellation_buffer_size[2] = l2_size;
+
+    ts_initialize.tessellation_stride = stride;
+    ts_initialize.tessellation_width_height = width | (height << 16);
+    ts_initialize.tessellation_shift = 0;
+
+    return VG_LITE_SUCCESS;
+}
+
+static void return_tessellation(vg_lite_kernel_initialize_t * data)
+{
+    data->tessellation_buffer_gpu[0] = ts_initialize.tessellation_buffer_gpu[0];
+    data->tessellation_buffer_gpu[1] = ts_initialize.tessellation_buffer_gpu[1];
+    data->tessellation_buffer_gpu[2] = ts_initialize.tessellation_buffer_gpu[2];
+    data->tessellation_buffer_logic[0] = ts_initialize.tessellation_buffer_logic[0];
+    data->tessellation_buffer_logic[1] = ts_initialize.tessellation_buffer_logic[1];
+    data->tessellation_buffer_logic[2] = ts_initialize.tessellation_buffer_logic[2];
+    data->tessellation_buffer_size[0] = ts_initialize.tessellation_buffer_size[0];
+    data->tessellation_buffer_size[1] = ts_initialize.tessellation_buffer_size[1];
+    data->tessellation_buffer_size[2] = ts_initialize.tessellation_buffer_size[2];
+
+    data->tessellation_stride = ts_initialize.tessellation_stride;
+    data->tessellation_width_height = ts_initialize.tessellation_width_height;
+    data->tessellation_shift = ts_initialize.tessellation_shift;
+}
+
+/* Replace the tessellation buffer with one for a new window. All contexts
+ * share the buffer, so this is only possible while a single context is open. */
+static vg_lite_error_t do_resize_tessellation(vg_lite_kernel_initialize_t * data)
+{
+    vg_lite_error_t error;
+    uint32_t old_window = ts_initialize.tessellation_width_height;
+    void *old_buffer = ts_buffer;
+
+    if (data->tessellation_width <= 0 || data->tessellation_height <= 0)
+        return VG_LITE_INVALID_ARGUMENT;
+    if (task_num != 1)
+        return VG_LITE_NOT_SUPPORT;
+
+    data->capabilities.data = 0;
+    if (vg_lite_hal_peek(VG_LITE_HW_CHIP_ID) >= 0x300)
+        data->capabilities.cap.l2_cache = 1;
+
+    /* Keep the old buffer unless memory is too short for both. */
+    error = allocate_tessellation(data->context, data);
+    if (error != VG_LITE_SUCCESS && old_buffer != NULL) {
+        vg_lite_hal_free_contiguous(old_buffer);
+        old_buffer = NULL;
+        error = allocate_tessellation(data->context, data);
+        if (error != VG_LITE_SUCCESS) {
+            /* Fall back to the old window. */
+            data->tessellation_width = old_window & 0xFFFF;
+            data->tessellation_height = old_window >> 16;
+            if (allocate_tessellation(data->context, data) != VG_LITE_SUCCESS) {
+                ts_buffer = NULL;
+                ts_init = 0;
+                data->context->tessellation_buffer = NULL;
+                return error;
+            }
+            return_tessellation(data);
+            return error;
+        }
+    }
+    if (error != VG_LITE_SUCCESS)
+        return error;
+
+    if (old_buffer != NULL)
+        vg_lite_hal_free_contiguous(old_buffer);
+    ts_init = 1;
+    return_tessellation(data);
+
+    return VG_LITE_SUCCESS;
+}
+
+static vg_lite_error_t do_set_priority(vg_lite_kernel_priority_t * data)
+{
+#if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
+    return (vg_lite_error_t)vg_lite_os_set_priority(&data->context->async_event[0],
+                                                    data->priority);
+#else
+    return VG_LITE_NOT_SUPPORT;
+#endif
+}
+
 static void soft_reset(void);
 
 static void gpu(int enable)
@@ -116,7 +248,6 @@ static vg_lite_error_t init_vglite(vg_lite_kernel_initialize_t * data)
     vg_lite_kernel_context_t * context;
     uint32_t id;
     int      i;
-    uint32_t chip_id = 0;
 
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
     uint32_t semaphore_id = 0;
@@ -279,40 +410,9 @@ static vg_lite_error_t init_vglite(vg_lite_kernel_initialize_t * data)
     /* Allocate the tessellation buffer. */
     if ((data->tessellation_width > 0) && (data->tessellation_height > 0)) 
     {
-        int width = data->tessellation_width;
-        int height = 0;
-        height = VG_LITE_ALIGN(data->tessellation_height, 16);
-
-        chip_id = vg_lite_hal_peek(0x20);
-        if(chip_id == GPU_CHIP_ID_GC355)
-            width = VG_LITE_ALIGN(width, 128);
-        /* Check if we can used tiled tessellation (128x16). */
-        if (((width & 127) == 0) && ((height & 15) == 0)) {
-            data->capabilities.cap.tiled = 0x3;
-        } else {
-            data->capabilities.cap.tiled = 0x2;
-        }
-
         if(ts_init++ == 0)
         {
-            unsigned long stride, buffer_size, l1_size, l2_size;
-
-            /* Compute tessellation buffer size. */
-            stride = VG_LITE_ALIGN(width * 8, 64);
-            buffer_size = VG_LITE_ALIGN(stride * height, 64);
-            /* Each bit in the L1 cache represents 64 bytes of tessellation data. */
-            l1_size = VG_LITE_ALIGN(VG_LITE_ALIGN(buffer_size / 64, 64) / 8, 64);
-            /* Each bit in the L2 cache represents 32 bytes of L1 data. */
-            l2_size = data->capabilities.cap.l2_cache ? VG_LITE_ALIGN(VG_LITE_ALIGN(l1_size / 32, 64) / 8, 64) : 0;
-
-            /* Allocate the memory. */
-            vg_lite_os_lock();
-            error = vg_lite_hal_allocate_contiguous(buffer_size + l1_size + l2_size,
-                                                                           &context->tessellation_buffer_logical,
-                                                                           &context->tessellation_buffer_physical,
-                                                                           &context->tessellation_buffer);
-            vg_lite_os_unlock();
-
+            error = allocate_tessellation(context, data);
             if (error != VG_LITE_SUCCESS) {
                 /* Free any allocated memory. */
                 vg_lite_kernel_terminate_t terminate = { context };
@@ -321,37 +421,11 @@ static vg_lite_error_t init_vglite(vg_lite_kernel_initialize_t * data)
                 /* Out of memory. */
                 return error;
             }
-
-            /* Return the tessellation buffer pointers and GPU addresses. */
-            ts_initialize.tessellation_buffer_gpu[0] = context->tessellation_buffer_physical;
-            ts_initialize.tessellation_buffer_gpu[1] = context->tessellation_buffer_physical + buffer_size;
-            ts_initialize.tessellation_buffer_gpu[2] = (l2_size ? ts_initialize.tessellation_buffer_gpu[1] + l1_size
-                                                : ts_initialize.tessellation_buffer_gpu[1]);
-            ts_initialize.tessellation_buffer_logic[0] = (uint8_t *)context->tessellation_buffer_logical;
-            ts_initialize.tessellation_buffer_logic[1] = ts_initialize.tessellation_buffer_logic[0] + buffer_size;
-            ts_initialize.tessellation_buffer_logic[2] = (l2_size ? ts_initialize.tessellation_buffer_logic[1] + l1_size
-                                                  : ts_initialize.tessellation_buffer_logic[1]);
-            ts_initialize.tessellation_buffer_size[0] = buffer_size;
-            ts_initialize.tessellation_buffer_size[1] = l1_size;
-            ts_initialize.tessellation_buffer_size[2] = l2_size;
-
-            ts_initialize.tessellation_stride = stride;
-            ts_initialize.tessellation_width_height = width | (height << 16);
-            ts_initialize.tessellation_shift = 0;
         }
-        data->tessellation_buffer_gpu[0] = ts_initialize.tessellation_buffer_gpu[0];
-        data->tessellation_buffer_gpu[1] = ts_initialize.tessellation_buffer_gpu[1];
-        data->tessellation_buffer_gpu[2] = ts_initialize.tessellation_buffer_gpu[2];
-        data->tessellation_buffer_logic[0] = ts_initialize.tessellation_buffer_logic[0];
-        data->tessellation_buffer_logic[1] = ts_initialize.tessellation_buffer_logic[1];
-        data->tessellation_buffer_logic[2] = ts_initialize.tessellation_buffer_logic[2];
-        data->tessellation_buffer_size[0] = ts_initialize.tessellation_buffer_size[0];
-        data->tessellation_buffer_size[1] = ts_initialize.tessellation_buffer_size[1];
-        data->tessellation_buffer_size[2] = ts_initialize.tessellation_buffer_size[2];
-
-        data->tessellation_stride = ts_initialize.tessellation_stride;
-        data->tessellation_width_height = ts_initialize.tessellation_width_height;
-        data->tessellation_shift = ts_initialize.tessellation_shift;
+        else {
+            data->capabilities.cap.tiled = ts_initialize.capabilities.cap.tiled;
+        }
+        return_tessellation(data);
     }
 
     if(task_num == 1)
@@ -448,12 +522,14 @@ static vg_lite_error_t terminate_vglite(vg_lite_kernel_terminate_t * data)
 #endif
 
     if(task_num == 0){
-        if (context->tessellation_buffer) {
-            /* Free the tessellation buffer. */
-            vg_lite_hal_free_contiguous(context->tessellation_buffer);
-            context->tessellation_buffer = NULL;
+        if (ts_buffer) {
+            /* Free the tessellation buffer, it may belong to a closed context. */
+            vg_lite_hal_free_contiguous(ts_buffer);
+            ts_buffer = NULL;
         }
+        context->tessellation_buffer = NULL;
         ts_init = 0;
+        suspended = 0;
         /* Disable the GPU. */
         gpu(0);
 
@@ -528,6 +604,10 @@ static vg_lite_error_t do_submit(vg_lite_kernel_submit_t * data)
         return VG_LITE_NO_CONTEXT;
     }
 #endif
+    /* The GPU clock is off until vg_lite_resume. */
+    if (suspended)
+        return VG_LITE_NOT_SUPPORT;
+
     /* Perform a memory barrier. */
     vg_lite_hal_barrier();
 
@@ -562,6 +642,50 @@ static vg_lite_error_t do_reset(void)
     return VG_LITE_SUCCESS;
 }
 
+/* Stop the GPU clock between bursts of work. Contexts, command and
+ * tessellation buffers and the heap are kept, so the GPU can be power gated
+ * and brought back by do_resume without a new initialization. */
+static vg_lite_error_t do_suspend(void)
+{
+    uint32_t delay = 1;
+    const uint32_t delay_limit = 1000;
+
+    if (s_reference == 0)
+        return VG_LITE_NO_CONTEXT;
+    if (suspended)
+        return VG_LITE_SUCCESS;
+
+    /* Unlike gpu(0), do not force the clock off under running work. */
+    while (!VG_LITE_KERNEL_IS_GPU_IDLE()) {
+        if (delay > delay_limit)
+            return VG_LITE_TIMEOUT;
+        vg_lite_hal_delay(delay);
+        delay *= 2;
+    }
+
+    vg_lite_hal_poke(VG_LITE_INTR_ENABLE, 0);
+    gpu(0);
+    suspended = 1;
+
+    return VG_LITE_SUCCESS;
+}
+
+/* Only the clock setup and soft reset are needed, the registers are
+ * programmed again by the command stream. */
+static vg_lite_error_t do_resume(void)
+{
+    if (s_reference == 0)
+        return VG_LITE_NO_CONTEXT;
+    if (!suspended)
+        return VG_LITE_SUCCESS;
+
+    gpu(1);
+    vg_lite_hal_poke(VG_LITE_INTR_ENABLE, 0xFFFFFFFF);
+    suspended = 0;
+
+    return VG_LITE_SUCCESS;
+}
+
 static vg_lite_error_t do_debug(void)
 {
     return VG_LITE_SUCCESS;
@@ -696,6 +820,22 @@ vg_lite_error_t vg_lite_kernel(vg_lite_kernel_command_t command, void * data)
             /* query context switch */
             return do_query_context_switch(data);
 
+        case VG_LITE_SET_PRIORITY:
+            /* Set context priority */
+            return do_set_priority(data);
+
+        case VG_LITE_RESIZE_TESSELLATION:
+            /* Replace the tessellation buffer */
+            return do_resize_tessellation(data);
+
+        case VG_LITE_SUSPEND:
+            /* Stop the GPU clock */
+            return do_suspend();
+
+        case VG_LITE_RESUME:
+            /* Restart the GPU */
+            return do_resume();
+
         default:
             break;
     }
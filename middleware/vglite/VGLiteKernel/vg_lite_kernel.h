@@ -67,6 +67,18 @@
 #define GPU_CHIP_ID_GCNanoliteV         0x255
 #define GPU_CHIP_ID_GC355               0x355
 
+/* Tessellation buffer layout for a window, shared by the kernel allocating
+ * it and the driver fitting it in a budget. */
+#define VG_LITE_TS_WIDTH(width, chip_id)        \
+        ((chip_id) == GPU_CHIP_ID_GC355 ? VG_LITE_ALIGN(width, 128) : (width))
+#define VG_LITE_TS_STRIDE(width)                VG_LITE_ALIGN((width) * 8, 64)
+#define VG_LITE_TS_BUFFER_SIZE(stride, height)  VG_LITE_ALIGN((stride) * (height), 64)
+/* Each bit in the L1 cache represents 64 bytes of tessellation data. */
+#define VG_LITE_TS_L1_SIZE(buffer_size)         VG_LITE_ALIGN(VG_LITE_ALIGN((buffer_size) / 64, 64) / 8, 64)
+/* Each bit in the L2 cache represents 32 bytes of L1 data. */
+#define VG_LITE_TS_L2_SIZE(l1_size, l2_cache)   \
+        ((l2_cache) ? VG_LITE_ALIGN(VG_LITE_ALIGN((l1_size) / 32, 64) / 8, 64) : 0)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -167,6 +179,19 @@ typedef enum vg_lite_kernel_command
 
     /* query context switch. */
     VG_LITE_QUERY_CONTEXT_SWITCH,
+
+    /* Set context priority. */
+    VG_LITE_SET_PRIORITY,
+
+    /* Resize the tessellation buffer, takes a vg_lite_kernel_initialize_t
+       using only the context and tessellation fields. */
+    VG_LITE_RESIZE_TESSELLATION,
+
+    /* Stop the GPU clock, keeping all allocations. */
+    VG_LITE_SUSPEND,
+
+    /* Restart the GPU after a suspend. */
+    VG_LITE_RESUME,
 }
 vg_lite_kernel_command_t;
 
@@ -412,6 +437,16 @@ typedef struct vg_lite_kernel_context_switch
 }
 vg_lite_kernel_context_switch_t;
 
+typedef struct vg_lite_kernel_priority
+{
+    /* Context to set the priority for. */
+    vg_lite_kernel_context_t * context;
+
+    /* Submit priority, higher values are served first. */
+    uint32_t priority;
+}
+vg_lite_kernel_priority_t;
+
 vg_lite_error_t vg_lite_kernel(vg_lite_kernel_command_t command, void * data);
 
 #ifdef  __cplusplus
@@ -188,6 +188,13 @@ extern "C" {
      */
     typedef ElmHandle ElmBuffer;
 
+    /*!
+     @typedef ElmLoadCallback
+     Completion callback of ElmCreateObjectAsync. handle is the created object, or ELM_NULL_HANDLE if
+     loading failed; data is the data pointer the load was requested with.
+     */
+    typedef void (*ElmLoadCallback)(ElmHandle handle, void *data);
+
     #define TRUE  1
     #define FALSE 0
     /*!
@@ -259,6 +266,72 @@ extern "C" {
      */
     ElmHandle ElmCreateObjectFromData(ELM_OBJECT_TYPE type, void *data, int size);
 
+    /*!
+     @abstract Create an elementary object referencing read-only data in place.
+
+     @discussion
+     Same as ElmCreateObjectFromData, except that the EVO path data and gradient colors are referenced
+     where they are instead of being copied, so only the mutable object state is allocated. The data can
+     be in XIP flash or a memory mapped file (mmap), and must stay valid and unchanged until the object
+     is destroyed. Misaligned blobs are still copied.
+
+     @param type
+     Specify what type of object to be created.
+
+     @param data
+     The pointer to the binary data which has exactly same layout as external resource file.
+
+     @param size
+     The size of the data in bytes.
+
+     @return ElmHandle
+     An object handle depending on the corresponding type. If type mismatches with the binary data, it
+     returns ELM_NULL_HANDLE.
+     */
+    ElmHandle ElmCreateObjectFromMappedData(ELM_OBJECT_TYPE type, const void *data, int size);
+
+    /*!
+     @abstract Create an elementary object in the background.
+
+     @discussion
+     Parsing the data, copying the paths and generating the gradient ramps is done on a low priority
+     loader task, so large assets can be loaded without stalling the render loop. Paths whose coordinates
+     are all 16-bit integers are stored in the S16 format there, halving their size. The object only gets
+     its handle once ElmPollAsync is called on the rendering task, which then invokes the callback.
+     Groups containing text, text and font objects, and builds without a loader task (bare-metal or
+     static object pools) are loaded synchronously by this call and reported on the next ElmPollAsync.
+     The data must stay valid until the callback has been invoked.
+
+     @param type
+     Specify what type of object to be created.
+
+     @param data
+     The pointer to the binary data which has exactly same layout as external resource file.
+
+     @param size
+     The size of the data in bytes.
+
+     @param callback
+     The function to call with the new handle, it may be NULL.
+
+     @return BOOL
+     If the load was queued.
+     */
+    BOOL ElmCreateObjectAsync(ELM_OBJECT_TYPE type, void *data, int size, ElmLoadCallback callback);
+
+    /*!
+     @abstract Publish the objects loaded in the background.
+
+     @discussion
+     Hands out the handles of the finished ElmCreateObjectAsync loads and invokes their callbacks. It must
+     be called from the rendering task, typically once per frame, and until it returns 0 before
+     ElmTerminate.
+
+     @return uint32_t
+     The number of loads still in progress.
+     */
+    uint32_t ElmPollAsync(void);
+
     /*!
      @abstract Rotate a graphics object with centain degree
 
@@ -360,6 +433,58 @@ extern "C" {
      */
     BOOL ElmDraw(ElmBuffer buffer, ElmHandle object);
 
+    /*!
+     @abstract Redraw only the part of a buffer that changed.
+
+     @discussion
+     The damage of a group is the union of the old and new bounding boxes of
+     the children changed since its previous ElmDrawDamaged. Each buffer
+     remembers the frame it last received, so with double or triple buffering
+     the damage of all the frames a buffer missed is redrawn. The damaged area
+     is cleared with color and the group is drawn under a scissor. A buffer new
+     to the object, or more than four frames behind, is redrawn fully.
+     Other object types are always drawn fully.
+
+     @param buffer
+     The render buffer.
+
+     @param object
+     The object drawn into the buffer every frame.
+
+     @param color
+     The clear color of the damaged area.
+
+     @return bool
+     The draw operation for this elmentary object is sucessful.
+     */
+    BOOL ElmDrawDamaged(ElmBuffer buffer, ElmHandle object, uint32_t color);
+
+    /*!
+     @abstract Find the children of a group under a point.
+
+     @discussion
+     The children are filed in a grid over their transformed bounding boxes, built on the first call
+     and updated incrementally as children are transformed. The candidates of the grid cell holding the
+     point are then tested exactly: image nodes against their rectangle, paths under their fill rule
+     (even-odd or non-zero) with the curves flattened. Text and pattern children are never hit.
+
+     @param group
+     The group to test.
+
+     @param x, y
+     The pixel to test, in render target coordinates.
+
+     @param results
+     Receives the handles of the children under the pixel, topmost first.
+
+     @param max
+     The size of results.
+
+     @return uint32_t
+     The number of handles written to results.
+     */
+    uint32_t ElmHitTest(ElmGroupObj group, int x, int y, ElmHandle *results, uint32_t max);
+
     /*!
      @abstract Set the rendering quality of an graphics object.
 
@@ -493,6 +618,43 @@ extern "C" {
      */
     BOOL ElmSetPaintType(ElmVecObj evo, ELM_PAINT_TYPE type);
 
+    /*!
+     @abstract Hint that a group, or a group child, is static and worth caching.
+
+     @discussion
+     A hinted group is rendered once into an offscreen layer in the render
+     target format, and then composited with one blit per frame until its
+     content or transform changes. When the current vector (ElmSetCurrentVector)
+     is set, only that child is hinted; consecutive hinted children share one
+     layer. Layers count against the budget set by ElmSetLayerCacheBudget.
+
+     @param obj
+     The group object.
+
+     @param enable
+     Cache the object or not.
+
+     @return bool
+     The operation is successful or not. Not supported in DDRLESS builds.
+     */
+    BOOL ElmSetCacheHint(ElmHandle obj, BOOL enable);
+
+    /*!
+     @abstract Set the layer cache budget.
+
+     @discussion
+     Layers of the objects hinted with ElmSetCacheHint are kept within this many
+     bytes, the least recently drawn ones are evicted first. Lowering the budget
+     evicts immediately.
+
+     @param bytes
+     The budget in bytes.
+
+     @return bool
+     The operation is successful or not.
+     */
+    BOOL ElmSetLayerCacheBudget(uint32_t bytes);
+
     /*!
      @abstract Create internal render buffer.
 
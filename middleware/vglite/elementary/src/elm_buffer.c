@@ -166,6 +166,8 @@ ElmBuffer ElmWrapBuffer(int width, int height, int stride,
             buffer->address = physical;
             buffer->format = _buffer_format_to_vglite(format);
             buffer->tiled  = VG_LITE_LINEAR;
+            buffer_obj->damage_object = ELM_NULL_HANDLE;
+            buffer_obj->damage_serial = 0;
             JUMP_IF_NON_ZERO_VALUE(add_object((el_Object *)buffer_obj), error_exit);
             handle = buffer_obj->object.handle;
         }
@@ -25,6 +25,7 @@
 *
 *****************************************************************************/
 
+#include <math.h>
 #include "elm_precom.h"
 
 #if (VG_RENDER_TEXT==1)
@@ -51,6 +52,449 @@ static void multiply(vg_lite_matrix_t * matrix, vg_lite_matrix_t * mult)
 
 }
 
+/* Grow the box dst to contain the box src, empty boxes are ignored. */
+static void union_bounds(float *dst, const float *src)
+{
+    if (src[2] <= src[0] || src[3] <= src[1])
+        return;
+    if (dst[2] <= dst[0] || dst[3] <= dst[1]) {
+        memcpy(dst, src, 4 * sizeof(float));
+        return;
+    }
+    if (src[0] < dst[0]) dst[0] = src[0];
+    if (src[1] < dst[1]) dst[1] = src[1];
+    if (src[2] > dst[2]) dst[2] = src[2];
+    if (src[3] > dst[3]) dst[3] = src[3];
+}
+
+/* Lift the ElmDrawDamaged scissor while rendering offscreen. */
+static void suspend_scissor(void)
+{
+    elm_tls_t *elm_tls = (elm_tls_t *) elm_os_get_tls();
+
+    if (elm_tls != NULL && elm_tls->gContext.scissor_enabled)
+        vg_lite_disable_scissor();
+}
+
+static void resume_scissor(void)
+{
+    elm_tls_t *elm_tls = (elm_tls_t *) elm_os_get_tls();
+
+    if (elm_tls != NULL && elm_tls->gContext.scissor_enabled) {
+        vg_lite_set_scissor(elm_tls->gContext.scissor[0], elm_tls->gContext.scissor[1],
+                            elm_tls->gContext.scissor[2], elm_tls->gContext.scissor[3]);
+        vg_lite_enable_scissor();
+    }
+}
+
+BOOL alloc_group_transforms(el_GroupTransforms *xf, uint32_t count)
+{
+    float *block;
+    uint32_t bytes = count * (26 * sizeof(float) + sizeof(uint8_t));
+    uint32_t k;
+
+    memset(xf, 0, sizeof(*xf));
+    if (count == 0)
+        return TRUE;
+
+    block = (float *)elm_alloc(1, bytes);
+    if (block == NULL)
+        return FALSE;
+    memset(block, 0, bytes);
+
+    for (k = 0; k < 9; k++) {
+        xf->local[k] = block + k * count;
+        xf->world[k] = block + (9 + k) * count;
+    }
+    for (k = 0; k < 4; k++) {
+        xf->box[k]    = block + (18 + k) * count;
+        xf->bounds[k] = block + (22 + k) * count;
+    }
+    xf->own = (uint8_t *)(block + 26 * count);
+
+    return TRUE;
+}
+
+void free_group_transforms(el_GroupTransforms *xf)
+{
+    if (xf->local[0] != NULL)
+        elm_free(xf->local[0]);
+    memset(xf, 0, sizeof(*xf));
+}
+
+static void get_world(const el_GroupTransforms *xf, int i, vg_lite_matrix_t *matrix)
+{
+    int k;
+
+    for (k = 0; k < 9; k++) {
+        matrix->m[k / 3][k % 3] = xf->world[k][i];
+    }
+}
+
+static void get_bounds(const el_GroupTransforms *xf, int i, float *bounds)
+{
+    bounds[0] = xf->bounds[0][i];
+    bounds[1] = xf->bounds[1][i];
+    bounds[2] = xf->bounds[2][i];
+    bounds[3] = xf->bounds[3][i];
+}
+
+/* Copy the matrix and the box of a child into the transform block. */
+static void load_child_transform(el_Obj_Group *ego, int i)
+{
+    el_GroupTransforms *xf = &ego->xf;
+    el_Obj_EVO *evo = &ego->group.objects[i];
+    const vg_lite_matrix_t *matrix;
+    float box[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    int k;
+
+    if (evo->is_image) {
+        /* Image nodes are placed by their own matrix only. */
+        matrix = &evo->defaultAttrib.transform.matrix;
+        box[2] = (float)evo->img_width;
+        box[3] = (float)evo->img_height;
+    }
+    else {
+        matrix = &evo->attribute.transform.matrix;
+        memcpy(box, evo->data.path.bounding_box, sizeof(box));
+    }
+
+    for (k = 0; k < 9; k++) {
+        xf->local[k][i] = matrix->m[k / 3][k % 3];
+    }
+    for (k = 0; k < 4; k++) {
+        xf->box[k][i] = box[k];
+    }
+    xf->own[i] = evo->is_image ? 1 : 0;
+}
+
+/* world = group * local for the children [first, last). Each loop runs over
+ * contiguous arrays, so the compiler can vectorize it. */
+static void compose_transforms(el_GroupTransforms *xf, const vg_lite_matrix_t *group,
+                               int first, int last)
+{
+    const float *l0, *l1, *l2, *l;
+    const uint8_t *own = xf->own;
+    float g0, g1, g2, *w;
+    int row, column, i;
+
+    for (row = 0; row < 3; row++) {
+        g0 = group->m[row][0];
+        g1 = group->m[row][1];
+        g2 = group->m[row][2];
+        for (column = 0; column < 3; column++) {
+            l0 = xf->local[column];
+            l1 = xf->local[3 + column];
+            l2 = xf->local[6 + column];
+            l  = xf->local[row * 3 + column];
+            w  = xf->world[row * 3 + column];
+            for (i = first; i < last; i++) {
+                w[i] = own[i] ? l[i] : g0 * l0[i] + g1 * l1[i] + g2 * l2[i];
+            }
+        }
+    }
+}
+
+/* bounds = bounding box of box under world for the children [first, last). */
+static void transform_boxes(el_GroupTransforms *xf, int first, int last)
+{
+    float * const *m = xf->world;
+    const float *bx, *by;
+    float *b0 = xf->bounds[0], *b1 = xf->bounds[1], *b2 = xf->bounds[2], *b3 = xf->bounds[3];
+    float x, y, w, tx, ty;
+    int corner, i;
+
+    for (corner = 0; corner < 4; corner++) {
+        bx = xf->box[(corner & 1) ? 2 : 0];
+        by = xf->box[(corner & 2) ? 3 : 1];
+        for (i = first; i < last; i++) {
+            x  = bx[i];
+            y  = by[i];
+            w  = m[6][i] * x + m[7][i] * y + m[8][i];
+            tx = m[0][i] * x + m[1][i] * y + m[2][i];
+            ty = m[3][i] * x + m[4][i] * y + m[5][i];
+            if (w != 0.0f && w != 1.0f) {
+                tx /= w;
+                ty /= w;
+            }
+            if (corner == 0) {
+                b0[i] = b2[i] = tx;
+                b1[i] = b3[i] = ty;
+            }
+            else {
+                b0[i] = MIN(b0[i], tx);
+                b1[i] = MIN(b1[i], ty);
+                b2[i] = MAX(b2[i], tx);
+                b3[i] = MAX(b3[i], ty);
+            }
+        }
+    }
+}
+
+/* Whether a group child can be hit: text has no path bounds and pattern
+ * children are only drawn through their host. */
+static BOOL hit_indexable(el_Obj_EVO *evo)
+{
+    return evo->object.handle != ELM_NULL_HANDLE &&
+           evo->attribute.paint.type != ELM_PAINT_TEXT &&
+           !evo->is_pattern;
+}
+
+/* Grid cell of a scaled coordinate, clamped to the grid. */
+static uint32_t hit_cell(float v, uint32_t cells)
+{
+    if (v < 0.0f)
+        return 0;
+    if (v >= (float)cells)
+        return cells - 1;
+    return (uint32_t)v;
+}
+
+/* Cells covered by a box, empty (first > last) for an empty box. */
+static void hit_span(const el_HitIndex *index, const float *box, uint8_t *span)
+{
+    if (box[2] <= box[0] || box[3] <= box[1]) {
+        span[0] = span[1] = 1;
+        span[2] = span[3] = 0;
+        return;
+    }
+    span[0] = (uint8_t)hit_cell((box[0] - index->bounds[0]) * index->scale_x, index->cols);
+    span[1] = (uint8_t)hit_cell((box[1] - index->bounds[1]) * index->scale_y, index->rows);
+    span[2] = (uint8_t)hit_cell((box[2] - index->bounds[0]) * index->scale_x, index->cols);
+    span[3] = (uint8_t)hit_cell((box[3] - index->bounds[1]) * index->scale_y, index->rows);
+}
+
+void free_hit_index(el_HitIndex **index)
+{
+    if (*index == NULL)
+        return;
+
+    if ((*index)->items != NULL)
+        elm_free((*index)->items);
+    elm_free(*index);
+    *index = NULL;
+}
+
+/* File the children of a group in a grid over the group bounds, leaving
+ * spare room in every cell for children moving later. */
+static el_HitIndex *build_hit_index(el_Obj_Group *ego)
+{
+    el_HitIndex *index = NULL;
+    el_Obj_EVO *evo;
+    uint32_t count = ego->group.count;
+    uint32_t cols, cells, bytes, total, c, i, x, y;
+    float width, height, bounds[4];
+
+    if (count == 0 || count > 0xffff)
+        return NULL;
+
+    /* About one child per cell. */
+    for (cols = 1; cols * cols < count && cols < HIT_GRID_MAX; cols++)
+        ;
+    cells = cols * cols;
+
+    bytes = sizeof(el_HitIndex) + (cells + 1) * sizeof(uint32_t) +
+            cells * sizeof(uint16_t) + count * 4;
+    index = (el_HitIndex *)elm_alloc(1, bytes);
+    JUMP_IF_NULL(index, error_exit);
+
+    index->cell_start = (uint32_t *)(index + 1);
+    index->cell_count = (uint16_t *)(index->cell_start + cells + 1);
+    index->spans      = (uint8_t (*)[4])(index->cell_count + cells);
+    index->items      = NULL;
+    index->cols       = cols;
+    index->rows       = cols;
+    index->count      = count;
+    memcpy(index->bounds, ego->bounds, sizeof(index->bounds));
+    width  = index->bounds[2] - index->bounds[0];
+    height = index->bounds[3] - index->bounds[1];
+    index->scale_x = width > 0.0f ? (float)cols / width : 0.0f;
+    index->scale_y = height > 0.0f ? (float)cols / height : 0.0f;
+    memset(index->cell_count, 0, cells * sizeof(uint16_t));
+
+    /* Count the children of each cell. */
+    for (i = 0; i < count; i++) {
+        evo = &ego->group.objects[i];
+        if (hit_indexable(evo)) {
+            get_bounds(&ego->xf, i, bounds);
+            hit_span(index, bounds, index->spans[i]);
+        }
+        else {
+            memset(index->spans[i], 0, sizeof(index->spans[i]));
+            index->spans[i][0] = 1;
+        }
+        for (y = index->spans[i][1]; y <= index->spans[i][3]; y++) {
+            for (x = index->spans[i][0]; x <= index->spans[i][2]; x++) {
+                index->cell_count[y * cols + x]++;
+            }
+        }
+    }
+
+    total = 0;
+    for (c = 0; c < cells; c++) {
+        index->cell_start[c] = total;
+        total += index->cell_count[c] + index->cell_count[c] / 4 + 2;
+        index->cell_count[c] = 0;
+    }
+    index->cell_start[cells] = total;
+
+    index->items = (uint16_t *)elm_alloc(total, sizeof(uint16_t));
+    JUMP_IF_NULL(index->items, error_exit);
+
+    /* File them, in drawing order. */
+    for (i = 0; i < count; i++) {
+        for (y = index->spans[i][1]; y <= index->spans[i][3]; y++) {
+            for (x = index->spans[i][0]; x <= index->spans[i][2]; x++) {
+                c = y * cols + x;
+                index->items[index->cell_start[c] + index->cell_count[c]++] = (uint16_t)i;
+            }
+        }
+    }
+    index->valid = TRUE;
+
+    return index;
+
+error_exit:
+    free_hit_index(&index);
+
+    return NULL;
+}
+
+/* Re-file a moved child. The index is invalidated when a cell is full. */
+static void move_hit_item(el_HitIndex *index, uint32_t item, const float *box)
+{
+    uint8_t span[4];
+    uint16_t *items;
+    uint32_t c, k, n, x, y;
+
+    if (!index->valid || item >= index->count)
+        return;
+
+    hit_span(index, box, span);
+    if (memcmp(span, index->spans[item], sizeof(span)) == 0)
+        return;
+
+    /* Take it out of its old cells, keeping them in drawing order. */
+    for (y = index->spans[item][1]; y <= index->spans[item][3]; y++) {
+        for (x = index->spans[item][0]; x <= index->spans[item][2]; x++) {
+            c = y * index->cols + x;
+            items = &index->items[index->cell_start[c]];
+            n = index->cell_count[c];
+            for (k = 0; k < n && items[k] != item; k++)
+                ;
+            if (k < n) {
+                memmove(&items[k], &items[k + 1], (n - k - 1) * sizeof(uint16_t));
+                index->cell_count[c]--;
+            }
+        }
+    }
+
+    for (y = span[1]; y <= span[3]; y++) {
+        for (x = span[0]; x <= span[2]; x++) {
+            c = y * index->cols + x;
+            items = &index->items[index->cell_start[c]];
+            n = index->cell_count[c];
+            if (index->cell_start[c] + n == index->cell_start[c + 1]) {
+                index->valid = FALSE;
+                return;
+            }
+            for (k = n; k > 0 && items[k - 1] > item; k--)
+                ;
+            memmove(&items[k + 1], &items[k], (n - k) * sizeof(uint16_t));
+            items[k] = (uint16_t)item;
+            index->cell_count[c]++;
+        }
+    }
+    memcpy(index->spans[item], span, sizeof(span));
+}
+
+/* Bring the retained state of a group up to date: only the children whose
+ * transform changed get their world matrix and bounds recomputed, or all of
+ * them at once when the group transform changed. */
+static const float full_damage[4] = { -1.0e9f, -1.0e9f, 1.0e9f, 1.0e9f };
+
+static void update_group(el_Obj_Group *ego)
+{
+    el_GroupTransforms *xf = &ego->xf;
+    el_Obj_EVO *evo, *run = NULL;
+    uint32_t evo_dirty;
+    float bounds[4];
+    BOOL moved_all;
+    int i, count = (int)ego->group.count;
+
+    if (ego->dirty == 0)
+        return;
+
+    moved_all = (ego->dirty & ELM_DIRTY_TRANSFORM) || !xf->valid;
+    memset(ego->bounds, 0, sizeof(ego->bounds));
+
+    /* A new group transform moves everything, the hit index is rebuilt. */
+    if (moved_all && ego->hit_index != NULL)
+        ego->hit_index->valid = FALSE;
+
+    for (i = 0; i < count; i++) {
+        evo = &ego->group.objects[i];
+
+        /* Any change inside a cached range invalidates its layer. */
+        run = evo->cache_hint ? (run != NULL ? run : evo) : NULL;
+        if ((ego->dirty & ELM_DIRTY_TRANSFORM) || evo->dirty) {
+            if (run != NULL && run->layer != NULL)
+                run->layer->valid = FALSE;
+            if (ego->layer != NULL)
+                ego->layer->valid = FALSE;
+        }
+
+        evo_dirty = evo->dirty;
+        evo->dirty = 0;
+
+        if (evo->object.handle == ELM_NULL_HANDLE)
+            continue;
+
+        /* Text is placed by its own matrix and has no path bounds, pattern
+         * children are drawn through their host: their changes damage
+         * everything. Their boxes stay empty. */
+        if (evo->attribute.paint.type == ELM_PAINT_TEXT || evo->is_pattern) {
+            if (evo_dirty || (ego->dirty & ELM_DIRTY_TRANSFORM)) {
+                union_bounds(ego->damage, full_damage);
+            }
+            continue;
+        }
+
+        /* The old place of a moved node is damaged too. */
+        if (evo_dirty || moved_all) {
+            get_bounds(xf, i, bounds);
+            union_bounds(ego->damage, bounds);
+        }
+
+        if ((evo_dirty & ELM_DIRTY_TRANSFORM) || !xf->valid) {
+            load_child_transform(ego, i);
+            if (!moved_all) {
+                compose_transforms(xf, &ego->transform.matrix, i, i + 1);
+                transform_boxes(xf, i, i + 1);
+                get_bounds(xf, i, bounds);
+                union_bounds(ego->damage, bounds);
+                if (ego->hit_index != NULL)
+                    move_hit_item(ego->hit_index, i, bounds);
+            }
+        }
+    }
+
+    if (moved_all) {
+        compose_transforms(xf, &ego->transform.matrix, 0, count);
+        transform_boxes(xf, 0, count);
+        xf->valid = TRUE;
+    }
+
+    for (i = 0; i < count; i++) {
+        get_bounds(xf, i, bounds);
+        if (moved_all)
+            union_bounds(ego->damage, bounds);
+        union_bounds(ego->bounds, bounds);
+    }
+
+    ego->dirty = 0;
+}
+
 static vg_lite_filter_t quality_to_filter(ELM_QUALITY quality)
 {
     switch (quality) {
@@ -81,70 +525,164 @@ static vg_lite_pattern_mode_t pat_to_pad(ELM_PATTERN_MODE mode)
             break;
     }
 }
-static vg_lite_error_t draw_evo_pattern(el_Obj_Buffer *buff, el_Obj_Group *ego,int * index)
+/* Hash the state the pattern children of a group are rendered with,
+ * starting after the pattern host at index start. Path data is identified
+ * by its address and length only: changing it in place does not update the
+ * texture, a path must be given new data to be re-rendered. */
+static uint32_t pattern_signature(el_Obj_Group *ego, int start, int *end)
 {
     el_Obj_EVO *evo;
-    vg_lite_error_t error = VG_LITE_INVALID_ARGUMENT;
-    vg_lite_color_t color;
-    vg_lite_filter_t filter;
-    vg_lite_blend_t blend;
-    vg_lite_fill_t rule; 
-    vg_lite_buffer_t *buffer;
+    const uint8_t *bytes;
+    uint32_t hash = 2166136261u;
+    int i;
+    size_t j;
+
+    for (i = start + 1; i < (int)ego->group.count && ego->group.objects[i].is_pattern; i++) {
+        struct {
+            void                *path;
+            int32_t             path_length;
+            uint32_t            blend;
+            uint32_t            fill_rule;
+            uint32_t            color;
+            vg_lite_matrix_t    matrix;
+        } state;
+
+        evo = &ego->group.objects[i];
+        memset(&state, 0, sizeof(state));
+        state.path        = evo->data.path.path;
+        state.path_length = evo->data.path.path_length;
+        state.blend       = (uint32_t)evo->attribute.blend;
+        state.fill_rule   = (uint32_t)evo->attribute.fill_rule;
+        state.color       = (uint32_t)evo->attribute.paint.color;
+        memcpy(&state.matrix, &evo->attribute.transform.matrix, sizeof(state.matrix));
+
+        bytes = (const uint8_t *)&state;
+        for (j = 0; j < sizeof(state); j++) {
+            hash = (hash ^ bytes[j]) * 16777619u;
+        }
+    }
+
+    *end = i;
+    return hash;
+}
+
+/* Release the cached pattern texture of a pattern host EVO. */
+void free_pattern_texture(el_Obj_EVO *evo)
+{
+    if (evo->pattern_texture != NULL) {
+        /* The GPU may still sample it. */
+        vg_lite_finish();
+        vg_lite_free(evo->pattern_texture);
+        elm_free(evo->pattern_texture);
+        evo->pattern_texture = NULL;
+    }
+}
+
+/* Render the pattern children of a host EVO into its cached texture.
+ * The texture is only re-rendered when the children state changed, and is
+ * not tied to the render target, so a frame normally only pays the
+ * vg_lite_draw_pattern() of the host. */
+static vg_lite_error_t update_pattern_texture(el_Obj_Group *ego, int start, int *end)
+{
+    el_Obj_EVO *host = &ego->group.objects[start];
+    el_Obj_EVO *evo;
+    vg_lite_buffer_t *buffer = host->pattern_texture;
+    vg_lite_error_t error = VG_LITE_SUCCESS;
     vg_lite_matrix_t mat;
-    vg_lite_pattern_mode_t pat_mode;
-    int width = 0;
-    int height = 0;
+    uint32_t signature;
+    int width, height;
+    int i;
 
-    int start = *index;
-    int i = start;
-    evo = &ego->group.objects[i];
-    width  = (int)(evo->data.path.bounding_box[2] - evo->data.path.bounding_box[0]);
-    height = (int)(evo->data.path.bounding_box[3] - evo->data.path.bounding_box[1]);
-    buffer = (vg_lite_buffer_t *)malloc(sizeof(vg_lite_buffer_t));
-    memset(buffer,0,sizeof(vg_lite_buffer_t));
-    buffer->width = width;
-    buffer->height = height;
-    buffer->format = VG_LITE_RGBA8888;
-    error = vg_lite_allocate(buffer);
-    vg_lite_clear(buffer,NULL,0xffffffff);
-    i++;
-    evo = &ego->group.objects[i];
-    while(evo->is_pattern)
-    {
-        blend = (vg_lite_blend_t)evo->attribute.blend;
-        rule = (vg_lite_fill_t)evo->attribute.fill_rule;
-        color = (vg_lite_color_t)evo->attribute.paint.color;
-        memcpy(&mat, &(evo->attribute.transform.matrix), sizeof(mat));
-        error = vg_lite_draw(buffer, &evo->data.path,
-                                rule,
-                                &mat,
-                                blend,
-                                color);
-        if(error)
+    width  = (int)(host->data.path.bounding_box[2] - host->data.path.bounding_box[0]);
+    height = (int)(host->data.path.bounding_box[3] - host->data.path.bounding_box[1]);
+    if (width <= 0 || height <= 0)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    signature = pattern_signature(ego, start, end);
+    if (buffer != NULL &&
+        buffer->width == width && buffer->height == height &&
+        host->pattern_signature == signature) {
+        return VG_LITE_SUCCESS;
+    }
+
+    if (buffer != NULL && (buffer->width != width || buffer->height != height)) {
+        free_pattern_texture(host);
+        buffer = NULL;
+    }
+
+    if (buffer == NULL) {
+        buffer = (vg_lite_buffer_t *)elm_alloc(1, sizeof(vg_lite_buffer_t));
+        if (buffer == NULL)
+            return VG_LITE_OUT_OF_MEMORY;
+        memset(buffer, 0, sizeof(vg_lite_buffer_t));
+        buffer->width  = width;
+        buffer->height = height;
+        buffer->format = VG_LITE_RGBA8888;
+        error = vg_lite_allocate(buffer);
+        if (error) {
+            elm_free(buffer);
             return error;
-        i++;
+        }
+        host->pattern_texture = buffer;
+    }
+
+    /* Earlier draws may still sample the texture, the re-render waits for
+     * them in the command stream and the host draw for the re-render. */
+    host->pattern_signature = 0;
+    error = vg_lite_barrier();
+    if (error)
+        return error;
+    suspend_scissor();
+    error = vg_lite_clear(buffer, NULL, 0xffffffff);
+    for (i = start + 1; !error && i < *end; i++) {
         evo = &ego->group.objects[i];
+        memcpy(&mat, &(evo->attribute.transform.matrix), sizeof(mat));
+        error = vg_lite_draw(buffer, &evo->data.path,
+                             (vg_lite_fill_t)evo->attribute.fill_rule,
+                             &mat,
+                             (vg_lite_blend_t)evo->attribute.blend,
+                             (vg_lite_color_t)evo->attribute.paint.color);
     }
-    *index = i - 1;
+    resume_scissor();
+    if (!error)
+        error = vg_lite_barrier();
+    if (!error)
+        host->pattern_signature = signature;
+
+    return error;
+}
+
+static vg_lite_error_t draw_evo_pattern(el_Obj_Buffer *buff, el_Obj_Group *ego,int * index,
+                                        const vg_lite_matrix_t *offset)
+{
+    el_Obj_EVO *evo;
+    vg_lite_error_t error;
+    vg_lite_matrix_t mat;
+    int start = *index;
+    int end = start + 1;
+
+    error = update_pattern_texture(ego, start, &end);
+    *index = end - 1;
+    if (error)
+        return error;
+
     evo = &ego->group.objects[start];
-    blend = (vg_lite_blend_t)evo->attribute.blend;
-    rule = (vg_lite_fill_t)evo->attribute.fill_rule;
-    color = (vg_lite_color_t)evo->attribute.paint.color;
-    memcpy(&mat, &(evo->attribute.transform.matrix), sizeof(mat));
-    filter = VG_LITE_FILTER_POINT;
-    pat_mode = VG_LITE_PATTERN_COLOR;
+    if (offset != NULL) {
+        memcpy(&mat, offset, sizeof(mat));
+        multiply(&mat, &(evo->attribute.transform.matrix));
+    }
+    else {
+        memcpy(&mat, &(evo->attribute.transform.matrix), sizeof(mat));
+    }
     error = vg_lite_draw_pattern(&buff->buffer, &evo->data.path,
-                            rule,
+                            (vg_lite_fill_t)evo->attribute.fill_rule,
                             &mat,
-                            buffer,
+                            evo->pattern_texture,
                             &mat,
-                            blend,
-                            pat_mode,
-                            color,
-                            filter);
-    vg_lite_finish();
-    vg_lite_free(buffer);
-    free(buffer);
+                            (vg_lite_blend_t)evo->attribute.blend,
+                            VG_LITE_PATTERN_COLOR,
+                            (vg_lite_color_t)evo->attribute.paint.color,
+                            VG_LITE_FILTER_POINT);
     return error;
 }
 
@@ -258,6 +796,311 @@ static vg_lite_error_t draw_ebo(el_Obj_Buffer *buff, el_Obj_EBO *ebo, vg_lite_ma
 #endif
     return error;
 }
+/* Draw the children [first, last) of a group, with their world matrices
+ * optionally pre-multiplied by offset. */
+static vg_lite_error_t draw_group_range(el_Obj_Buffer *buff, el_Obj_Group *ego,
+                                        int first, int last,
+                                        const vg_lite_matrix_t *offset)
+{
+    el_Obj_EVO *evo;
+    vg_lite_error_t error = VG_LITE_SUCCESS;
+    vg_lite_matrix_t mat, world;
+    int i;
+
+    for (i = first; i < last; i++)
+    {
+        evo = &ego->group.objects[i];
+
+        /* Font objects may generate empty objects */
+        if (evo->object.handle == ELM_NULL_HANDLE)
+            continue;
+
+        get_world(&ego->xf, i, &world);
+        if (offset != NULL)
+        {
+            memcpy(&mat, offset, sizeof(mat));
+            multiply(&mat, &world);
+            memcpy(&world, &mat, sizeof(world));
+        }
+
+        if(evo->is_image)
+        {
+            el_Obj_EBO *ebo;
+
+            /* Resolve the image once, later frames only blit it. */
+            if (evo->ebo == ELM_NULL_HANDLE)
+            {
+                evo->ebo = acquire_image(evo->eboname);
+                if (evo->ebo == ELM_NULL_HANDLE)
+                {
+                    error = VG_LITE_INVALID_ARGUMENT;
+                    continue;
+                }
+            }
+            ebo = (el_Obj_EBO *)get_object(evo->ebo);
+            if (ebo == NULL)
+            {
+                error = VG_LITE_INVALID_ARGUMENT;
+                continue;
+            }
+
+            if (draw_ebo(buff, ebo, &world) != VG_LITE_SUCCESS)
+            {
+                error = VG_LITE_INVALID_ARGUMENT;
+            }
+            continue;
+        }
+
+        if(evo->has_pattern)
+            error = draw_evo_pattern(buff, ego, &i, offset);
+        else
+            error = draw_evo(buff, evo, &world);
+        if (error)
+            return error;
+    }
+
+    return error;
+}
+
+#if !DDRLESS
+/* Offscreen format of a layer: the target one when it has alpha. */
+static vg_lite_buffer_format_t layer_format(vg_lite_buffer_format_t format)
+{
+    switch (format) {
+        case VG_LITE_RGBX8888:
+        case VG_LITE_RGB565:
+            return VG_LITE_RGBA8888;
+
+        case VG_LITE_BGRX8888:
+        case VG_LITE_BGR565:
+            return VG_LITE_BGRA8888;
+
+        default:
+            return format;
+    }
+}
+
+/* Find or allocate the layer of a node, evicting the least recently used
+ * layers to stay in the budget. Returns NULL when it cannot be cached. */
+static el_Layer *acquire_layer(el_Context *context, el_Layer **owner,
+                               vg_lite_buffer_t *target,
+                               int32_t x, int32_t y, int32_t width, int32_t height)
+{
+    el_Layer *layer = *owner, *lru, *node;
+    vg_lite_buffer_format_t format = layer_format(target->format);
+    uint32_t size;
+
+    if (layer != NULL) {
+        if (layer->target.buffer.width == width &&
+            layer->target.buffer.height == height &&
+            layer->target.buffer.format == format) {
+            if (layer->x != x || layer->y != y ||
+                layer->target_width != target->width ||
+                layer->target_height != target->height) {
+                layer->x = x;
+                layer->y = y;
+                layer->target_width = target->width;
+                layer->target_height = target->height;
+                layer->valid = FALSE;
+            }
+            return layer;
+        }
+        free_layer(owner);
+    }
+
+    size = (uint32_t)width * (uint32_t)height * ((format == VG_LITE_RGBA8888 || format == VG_LITE_BGRA8888) ? 4 : 2);
+    if (size > context->layer_budget)
+        return NULL;
+
+    while (context->layer_bytes + size > context->layer_budget) {
+        lru = context->layers;
+        for (node = context->layers; node != NULL; node = node->next) {
+            if (node->last_used < lru->last_used)
+                lru = node;
+        }
+        free_layer(lru->owner);
+    }
+
+    layer = (el_Layer *)elm_alloc(1, sizeof(el_Layer));
+    if (layer == NULL)
+        return NULL;
+    memset(layer, 0, sizeof(el_Layer));
+    layer->target.object.type = ELM_OBJECT_TYPE_BUF;
+    layer->target.buffer.width  = width;
+    layer->target.buffer.height = height;
+    layer->target.buffer.format = format;
+    if (vg_lite_allocate(&layer->target.buffer) != VG_LITE_SUCCESS) {
+        elm_free(layer);
+        return NULL;
+    }
+
+    layer->x = x;
+    layer->y = y;
+    layer->target_width = target->width;
+    layer->target_height = target->height;
+    layer->size = size;
+    layer->owner = owner;
+    layer->next = context->layers;
+    context->layers = layer;
+    context->layer_bytes += size;
+    *owner = layer;
+
+    return layer;
+}
+#endif
+
+/* Release a layer and clear the node field pointing to it. */
+void free_layer(el_Layer **owner)
+{
+#if !DDRLESS
+    elm_tls_t *elm_tls;
+    el_Layer *layer = *owner, **link;
+
+    elm_tls = (elm_tls_t *) elm_os_get_tls();
+    if (elm_tls == NULL || layer == NULL)
+        return;
+
+    for (link = &elm_tls->gContext.layers; *link != NULL; link = &(*link)->next) {
+        if (*link == layer) {
+            *link = layer->next;
+            break;
+        }
+    }
+    elm_tls->gContext.layer_bytes -= layer->size;
+
+    /* Earlier frames may still be compositing it. */
+    vg_lite_finish();
+    vg_lite_free(&layer->target.buffer);
+    elm_free(layer);
+#endif
+    *owner = NULL;
+}
+
+/* Evict the least recently used layers until the cache fits in budget. */
+void trim_layers(uint32_t budget)
+{
+#if !DDRLESS
+    elm_tls_t *elm_tls;
+    el_Layer *lru, *node;
+
+    elm_tls = (elm_tls_t *) elm_os_get_tls();
+    if (elm_tls == NULL)
+        return;
+
+    while (elm_tls->gContext.layers != NULL &&
+           elm_tls->gContext.layer_bytes > budget) {
+        lru = elm_tls->gContext.layers;
+        for (node = lru->next; node != NULL; node = node->next) {
+            if (node->last_used < lru->last_used)
+                lru = node;
+        }
+        free_layer(lru->owner);
+    }
+#endif
+}
+
+/* Draw the children [first, last) of a group through a cached layer: the
+ * layer is re-rendered only when invalidated, then composited with a blit. */
+static vg_lite_error_t draw_cached_range(el_Obj_Buffer *buff, el_Obj_Group *ego,
+                                         int first, int last, el_Layer **owner)
+{
+#if !DDRLESS
+    elm_tls_t *elm_tls;
+    el_Obj_EVO *evo;
+    el_Layer *layer;
+    vg_lite_error_t error;
+    vg_lite_matrix_t mat;
+    float bounds[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, child[4];
+    int32_t x0, y0, x1, y1;
+    int i;
+
+    elm_tls = (elm_tls_t *) elm_os_get_tls();
+    if (elm_tls == NULL)
+        return VG_LITE_NO_CONTEXT;
+
+    for (i = first; i < last; i++) {
+        evo = &ego->group.objects[i];
+        if (evo->object.handle == ELM_NULL_HANDLE)
+            continue;
+        /* Text is placed by its own matrix, it cannot be moved into a layer. */
+        if (evo->attribute.paint.type == ELM_PAINT_TEXT)
+            return draw_group_range(buff, ego, first, last, NULL);
+        get_bounds(&ego->xf, i, child);
+        union_bounds(bounds, child);
+    }
+    if (bounds[2] <= bounds[0] || bounds[3] <= bounds[1])
+        return VG_LITE_SUCCESS;
+
+    /* Clip the layer to the render target. */
+    x0 = MAX((int32_t)floorf(bounds[0]), 0);
+    y0 = MAX((int32_t)floorf(bounds[1]), 0);
+    x1 = MIN((int32_t)ceilf(bounds[2]), buff->buffer.width);
+    y1 = MIN((int32_t)ceilf(bounds[3]), buff->buffer.height);
+    if (x1 <= x0 || y1 <= y0)
+        return VG_LITE_SUCCESS;
+
+    layer = acquire_layer(&elm_tls->gContext, owner, &buff->buffer, x0, y0, x1 - x0, y1 - y0);
+    if (layer == NULL)
+        return draw_group_range(buff, ego, first, last, NULL);
+
+    if (!layer->valid) {
+        /* A reused layer may still be read by earlier composites, and the
+         * composite below must not read it before it is fully drawn. */
+        error = vg_lite_barrier();
+        if (error)
+            return error;
+        suspend_scissor();
+        error = vg_lite_clear(&layer->target.buffer, NULL, 0x00000000);
+        if (!error) {
+            vg_lite_identity(&mat);
+            vg_lite_translate((vg_lite_float_t)-x0, (vg_lite_float_t)-y0, &mat);
+            error = draw_group_range(&layer->target, ego, first, last, &mat);
+        }
+        resume_scissor();
+        if (!error)
+            error = vg_lite_barrier();
+        if (error)
+            return error;
+        layer->valid = TRUE;
+    }
+    layer->last_used = ++elm_tls->gContext.layer_clock;
+
+    vg_lite_identity(&mat);
+    vg_lite_translate((vg_lite_float_t)x0, (vg_lite_float_t)y0, &mat);
+    return vg_lite_blit(&buff->buffer, &layer->target.buffer, &mat,
+                        VG_LITE_BLEND_SRC_OVER, 0, VG_LITE_FILTER_POINT);
+#else
+    return draw_group_range(buff, ego, first, last, NULL);
+#endif
+}
+
+/*!
+ @abstract Set the layer cache budget.
+
+ @discussion
+ Layers of the objects hinted with ElmSetCacheHint are kept within this many
+ bytes, the least recently drawn ones are evicted first. Lowering the budget
+ evicts immediately.
+
+ @param bytes
+ The budget in bytes.
+
+ @return
+ If the opeartion is successfully done or not.
+ */
+BOOL ElmSetLayerCacheBudget(uint32_t bytes)
+{
+    elm_tls_t *elm_tls;
+
+    elm_tls = (elm_tls_t *) elm_os_get_tls();
+    if (elm_tls == NULL)
+        return FALSE;
+
+    elm_tls->gContext.layer_budget = bytes;
+    trim_layers(bytes);
+    return TRUE;
+}
+
 /*!
  @abstract Clear a render buffer with specified color and dimension.
 
@@ -324,7 +1167,7 @@ BOOL ElmClear(ElmBuffer buffer, uint32_t color, uint32_t x, uint32_t y, uint32_t
  */
 BOOL ElmFinish()
 {
-    vg_lite_finish();
+    vg_lite_end_frame();
     return TRUE;
 }
 
@@ -387,51 +1230,39 @@ BOOL ElmDraw(ElmBuffer buffer, ElmHandle object)
 
     if (elm->type == ELM_OBJECT_TYPE_EGO)
     {
-        el_Obj_EVO *evo;
         el_Obj_Group *ego = (el_Obj_Group *)elm;
-        vg_lite_matrix_t mat_group, res_mat;
 
         if (ego->group.count > 0)
         {
-            int i;
-            memcpy(&mat_group, &(ego->transform.matrix), sizeof(ego->transform.matrix));
-            for (i = 0; i < ego->group.count; i++)
-            {
-                evo = &ego->group.objects[i];
+            int i, j;
 
-                /* Font objects may generate empty objects */
-                if (evo->object.handle == ELM_NULL_HANDLE)
-                    continue;
-
-                if(evo->is_image)
+            update_group(ego);
+            if (ego->cache_hint)
+            {
+                error = draw_cached_range(buff, ego, 0, ego->group.count, &ego->layer);
+                if (error)
                 {
-                    ElmHandle ebo_handle;
-                    el_Object *elm_ebo;
-                    el_Obj_EBO *ebo;
-                    ebo_handle = ElmCreateObjectFromFile(ELM_OBJECT_TYPE_EBO, evo->eboname);
-                    elm_ebo = get_object(ebo_handle);
-                    ebo = (el_Obj_EBO *)elm_ebo;
-                    memcpy(&mat, &evo->defaultAttrib.transform.matrix, sizeof(mat));
-
-                    error = draw_ebo(buff, ebo, &mat);
+                    status = FALSE;
+                }
+            }
+            else
+            {
+                /* Runs of hinted children are composited from their layers. */
+                for (i = 0; i < ego->group.count; i = j)
+                {
+                    BOOL hint = ego->group.objects[i].cache_hint;
+
+                    for (j = i + 1; j < ego->group.count && ego->group.objects[j].cache_hint == hint; j++)
+                        ;
+                    if (hint)
+                        error = draw_cached_range(buff, ego, i, j, &ego->group.objects[i].layer);
+                    else
+                        error = draw_group_range(buff, ego, i, j, NULL);
                     if (error)
                     {
                         status = FALSE;
+                        break;
                     }
-                    continue;
-                }
-                memcpy(&mat, &(evo->attribute.transform.matrix), sizeof(mat));
-                memcpy(&res_mat, &mat_group, sizeof(mat_group));
-                multiply(&res_mat, &mat);
-
-                if(evo->has_pattern)
-                    error = draw_evo_pattern(buff,ego,&i);
-                else
-                    error = draw_evo(buff, evo, &res_mat);
-                if (error)
-                {
-                    status = FALSE;
-                    break;
                 }
             }
         }
@@ -481,3 +1312,389 @@ BOOL ElmDraw(ElmBuffer buffer, ElmHandle object)
     }
     return status;
 }
+
+/*!
+ @abstract Redraw only the part of a buffer that changed.
+
+ @discussion
+ The damage of a group is the union of the old and new bounding boxes of the
+ children changed since its previous ElmDrawDamaged. Each buffer remembers the
+ frame it last received, so with several buffers in flight the damage of all
+ the frames it missed is redrawn. The damaged area is cleared with color and
+ the group is drawn under a scissor. A buffer new to the object, or too many
+ frames behind, is redrawn fully. Other object types are always fully drawn.
+
+ @param buffer
+ The render buffer.
+
+ @param object
+ The object drawn into the buffer every frame.
+
+ @param color
+ The clear color of the damaged area.
+
+ @return bool
+ The draw operation for this elmentary object is sucessful.
+ */
+BOOL ElmDrawDamaged(ElmBuffer buffer, ElmHandle object, uint32_t color)
+{
+#if !DDRLESS
+    elm_tls_t *elm_tls;
+    el_Object *elm;
+    el_Obj_Buffer *buff;
+    el_Obj_Group *ego;
+    vg_lite_rectangle_t rect;
+    float damage[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    uint32_t serial, s;
+    BOOL status;
+
+    elm_tls = (elm_tls_t *) elm_os_get_tls();
+    elm = get_object(object);
+    buff = (el_Obj_Buffer *)get_object(buffer);
+    if (elm_tls == NULL || elm == NULL || buff == NULL)
+        return FALSE;
+
+    if (elm->type == ELM_OBJECT_TYPE_EGO) {
+        ego = (el_Obj_Group *)elm;
+        update_group(ego);
+
+        /* Close the frame of the group. */
+        serial = ++ego->damage_serial;
+        memcpy(ego->damage_history[serial % DAMAGE_HISTORY], ego->damage, sizeof(ego->damage));
+        memset(ego->damage, 0, sizeof(ego->damage));
+
+        /* Collect the frames the buffer missed. */
+        if (buff->damage_object != object || buff->damage_serial == 0 ||
+            serial - buff->damage_serial >= DAMAGE_HISTORY) {
+            memcpy(damage, full_damage, sizeof(damage));
+        }
+        else {
+            for (s = buff->damage_serial + 1; s != serial + 1; s++) {
+                union_bounds(damage, ego->damage_history[s % DAMAGE_HISTORY]);
+            }
+        }
+        buff->damage_object = object;
+        buff->damage_serial = serial;
+    }
+    else {
+        memcpy(damage, full_damage, sizeof(damage));
+        buff->damage_object = ELM_NULL_HANDLE;
+    }
+
+    /* Clip to the buffer. */
+    rect.x = MAX((int32_t)floorf(damage[0]), 0);
+    rect.y = MAX((int32_t)floorf(damage[1]), 0);
+    rect.width  = MIN((int32_t)ceilf(damage[2]), buff->buffer.width) - rect.x;
+    rect.height = MIN((int32_t)ceilf(damage[3]), buff->buffer.height) - rect.y;
+    if (rect.width <= 0 || rect.height <= 0)
+        return TRUE;
+
+    if (vg_lite_clear(&buff->buffer, &rect, color) != VG_LITE_SUCCESS)
+        return FALSE;
+
+    elm_tls->gContext.scissor[0] = rect.x;
+    elm_tls->gContext.scissor[1] = rect.y;
+    elm_tls->gContext.scissor[2] = rect.width;
+    elm_tls->gContext.scissor[3] = rect.height;
+    elm_tls->gContext.scissor_enabled = TRUE;
+    resume_scissor();
+
+    status = ElmDraw(buffer, object);
+
+    elm_tls->gContext.scissor_enabled = FALSE;
+    vg_lite_disable_scissor();
+
+    return status;
+#else
+    return ElmDraw(buffer, object);
+#endif
+}
+
+/* Inverse of a 3x3 matrix, FALSE if it is singular. */
+static BOOL invert(const vg_lite_matrix_t *matrix, vg_lite_matrix_t *result)
+{
+    const float (*m)[3] = matrix->m;
+    float det;
+    int row, column;
+
+    result->m[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+    result->m[0][1] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+    result->m[0][2] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+    result->m[1][0] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+    result->m[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+    result->m[1][2] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+    result->m[2][0] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+    result->m[2][1] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+    result->m[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+
+    det = m[0][0] * result->m[0][0] + m[0][1] * result->m[1][0] + m[0][2] * result->m[2][0];
+    if (det == 0.0f)
+        return FALSE;
+
+    for (row = 0; row < 3; row++) {
+        for (column = 0; column < 3; column++) {
+            result->m[row][column] /= det;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Winding of the edge (x0, y0)-(x1, y1) around (px, py), counted on the ray to +x. */
+static void hit_edge(float px, float py, float x0, float y0, float x1, float y1, int *winding)
+{
+    float side = (x1 - x0) * (py - y0) - (px - x0) * (y1 - y0);
+
+    if (y0 <= py) {
+        if (y1 > py && side > 0.0f)
+            (*winding)++;
+    }
+    else if (y1 <= py && side < 0.0f) {
+        (*winding)--;
+    }
+}
+
+/* Winding of a quadratic (degree 2) or cubic (degree 3) curve given by its
+ * points; only curves straddling the ray are flattened. */
+static void hit_curve(float px, float py, const float *p, int degree, int *winding)
+{
+    float min_x = p[0], max_x = p[0], min_y = p[1], max_y = p[1];
+    float t, u, x0, y0, x1, y1;
+    int k;
+
+    for (k = 1; k <= degree; k++) {
+        min_x = MIN(min_x, p[2 * k]);
+        max_x = MAX(max_x, p[2 * k]);
+        min_y = MIN(min_y, p[2 * k + 1]);
+        max_y = MAX(max_y, p[2 * k + 1]);
+    }
+
+    /* The curve stays within its control points. */
+    if (min_y > py || max_y <= py || max_x < px)
+        return;
+    if (min_x > px) {
+        hit_edge(px, py, p[0], p[1], p[2 * degree], p[2 * degree + 1], winding);
+        return;
+    }
+
+    x0 = p[0];
+    y0 = p[1];
+    for (k = 1; k <= HIT_CURVE_SEGMENTS; k++) {
+        t = (float)k / HIT_CURVE_SEGMENTS;
+        u = 1.0f - t;
+        if (degree == 2) {
+            x1 = u * u * p[0] + 2.0f * u * t * p[2] + t * t * p[4];
+            y1 = u * u * p[1] + 2.0f * u * t * p[3] + t * t * p[5];
+        }
+        else {
+            x1 = u * u * u * p[0] + 3.0f * u * u * t * p[2] + 3.0f * u * t * t * p[4] + t * t * t * p[6];
+            y1 = u * u * u * p[1] + 3.0f * u * u * t * p[3] + 3.0f * u * t * t * p[5] + t * t * t * p[7];
+        }
+        hit_edge(px, py, x0, y0, x1, y1, winding);
+        x0 = x1;
+        y0 = y1;
+    }
+}
+
+static float path_coord(const uint8_t *data, vg_lite_format_t format)
+{
+    switch (format) {
+        case VG_LITE_S8:
+            return (float)*(const int8_t *)data;
+        case VG_LITE_S16:
+            return (float)*(const int16_t *)data;
+        case VG_LITE_S32:
+            return (float)*(const int32_t *)data;
+        default:
+            return *(const float *)data;
+    }
+}
+
+/* Winding number of a path around (px, py), in path coordinates. Subpaths
+ * are closed as when filling. Arcs left unconverted count as their chord. */
+static int path_winding(const vg_lite_path_t *path, float px, float py)
+{
+    static const uint8_t coord_count[] = {
+        0, 0, 2, 2, 2, 2, 4, 4, 6, 6, 5, 5, 5, 5, 5, 5, 5, 5
+    };
+    const uint8_t *data = (const uint8_t *)path->path;
+    const uint8_t *end;
+    uint32_t unit, op, n, k;
+    float c[8] = { 0.0f };    /* Current point, then the command coordinates. */
+    float start_x = 0.0f, start_y = 0.0f;
+    int winding = 0;
+
+    if (data == NULL)
+        return 0;
+
+    unit = path->format == VG_LITE_S8 ? 1 : (path->format == VG_LITE_S16 ? 2 : 4);
+    end = data + path->path_length;
+
+    while (data + unit <= end) {
+        op = *data;
+        data += unit;
+        if (op == VLC_OP_END || op >= COUNT_OF(coord_count))
+            break;
+        n = coord_count[op];
+        if (data + n * unit > end)
+            break;
+        for (k = 0; k < n; k++) {
+            c[2 + k] = path_coord(data + k * unit, path->format);
+        }
+        data += n * unit;
+
+        /* Relative points are offset by the current point, arc radii and
+         * rotation are not. */
+        if ((op & 1) && op >= VLC_OP_MOVE_REL) {
+            for (k = (op >= VLC_OP_SCCWARC) ? 3 : 0; k < n; k += 2) {
+                c[2 + k] += c[0];
+                c[3 + k] += c[1];
+            }
+        }
+
+        switch (op) {
+            case VLC_OP_CLOSE:
+                hit_edge(px, py, c[0], c[1], start_x, start_y, &winding);
+                c[0] = start_x;
+                c[1] = start_y;
+                break;
+
+            case VLC_OP_MOVE:
+            case VLC_OP_MOVE_REL:
+                hit_edge(px, py, c[0], c[1], start_x, start_y, &winding);
+                c[0] = start_x = c[2];
+                c[1] = start_y = c[3];
+                break;
+
+            case VLC_OP_LINE:
+            case VLC_OP_LINE_REL:
+                hit_edge(px, py, c[0], c[1], c[2], c[3], &winding);
+                c[0] = c[2];
+                c[1] = c[3];
+                break;
+
+            case VLC_OP_QUAD:
+            case VLC_OP_QUAD_REL:
+                hit_curve(px, py, c, 2, &winding);
+                c[0] = c[4];
+                c[1] = c[5];
+                break;
+
+            case VLC_OP_CUBIC:
+            case VLC_OP_CUBIC_REL:
+                hit_curve(px, py, c, 3, &winding);
+                c[0] = c[6];
+                c[1] = c[7];
+                break;
+
+            default:
+                hit_edge(px, py, c[0], c[1], c[5], c[6], &winding);
+                c[0] = c[5];
+                c[1] = c[6];
+                break;
+        }
+    }
+    hit_edge(px, py, c[0], c[1], start_x, start_y, &winding);
+
+    return winding;
+}
+
+/* Exact test of a group child at (px, py) under its fill rule. */
+static BOOL hit_evo(el_Obj_Group *ego, int i, float px, float py)
+{
+    el_Obj_EVO *evo = &ego->group.objects[i];
+    vg_lite_matrix_t world, inverse;
+    float x, y, w;
+    int winding;
+
+    if (!hit_indexable(evo))
+        return FALSE;
+    if (px < ego->xf.bounds[0][i] || py < ego->xf.bounds[1][i] ||
+        px >= ego->xf.bounds[2][i] || py >= ego->xf.bounds[3][i])
+        return FALSE;
+
+    get_world(&ego->xf, i, &world);
+    if (!invert(&world, &inverse))
+        return FALSE;
+    w = inverse.m[2][0] * px + inverse.m[2][1] * py + inverse.m[2][2];
+    if (w == 0.0f)
+        return FALSE;
+    x = (inverse.m[0][0] * px + inverse.m[0][1] * py + inverse.m[0][2]) / w;
+    y = (inverse.m[1][0] * px + inverse.m[1][1] * py + inverse.m[1][2]) / w;
+
+    if (evo->is_image) {
+        return x >= 0.0f && y >= 0.0f &&
+               x < (float)evo->img_width && y < (float)evo->img_height;
+    }
+
+    winding = path_winding(&evo->data.path, x, y);
+    if (evo->attribute.fill_rule == ELM_EVO_FILL_EO)
+        return (winding & 1) != 0;
+
+    return winding != 0;
+}
+
+/*!
+ @abstract Find the children of a group under a point.
+
+ @discussion
+ The children are filed in a grid over their world bounding boxes, built on
+ the first call and updated as children move. The candidates of the cell of
+ the point are tested exactly: images against their rectangle, paths under
+ their fill rule with the curves flattened. Text and pattern children are
+ never hit.
+
+ @param group
+ The group to test.
+
+ @param x, y
+ The pixel to test, in render target coordinates.
+
+ @param results
+ The handles of the children hit, topmost first.
+
+ @param max
+ The size of results.
+
+ @return uint32_t
+ The number of children written to results.
+ */
+uint32_t ElmHitTest(ElmGroupObj group, int x, int y, ElmHandle *results, uint32_t max)
+{
+    el_Obj_Group *ego;
+    el_HitIndex *index;
+    float px = (float)x + 0.5f, py = (float)y + 0.5f;
+    uint32_t found = 0, c, k;
+    int i;
+
+    ego = (el_Obj_Group *)get_object(group);
+    if (ego == NULL || ego->object.type != ELM_OBJECT_TYPE_EGO ||
+        results == NULL || max == 0)
+        return 0;
+
+    update_group(ego);
+    if (ego->hit_index != NULL && !ego->hit_index->valid)
+        free_hit_index(&ego->hit_index);
+    if (ego->hit_index == NULL)
+        ego->hit_index = build_hit_index(ego);
+    index = ego->hit_index;
+
+    if (index == NULL) {
+        /* No room for the grid, test every child. */
+        for (i = (int)ego->group.count - 1; i >= 0 && found < max; i--) {
+            if (hit_evo(ego, i, px, py))
+                results[found++] = ego->group.objects[i].object.handle;
+        }
+        return found;
+    }
+
+    c = hit_cell((py - index->bounds[1]) * index->scale_y, index->rows) * index->cols +
+        hit_cell((px - index->bounds[0]) * index->scale_x, index->cols);
+    for (k = index->cell_count[c]; k > 0 && found < max; k--) {
+        i = index->items[index->cell_start[c] + k - 1];
+        if (hit_evo(ego, i, px, py))
+            results[found++] = ego->group.objects[i].object.handle;
+    }
+
+    return found;
+}
@@ -70,6 +70,13 @@ static int _initialize_elm(uint32_t width, uint32_t height)
     for (i = 0; i < SLOT_COUNT; i++) {
         elm_tls->gContext.object_slots[i] = NULL;
     }
+    memset(elm_tls->gContext.image_cache, 0, sizeof(elm_tls->gContext.image_cache));
+    elm_tls->gContext.layers       = NULL;
+    elm_tls->gContext.layer_budget = LAYER_CACHE_BUDGET;
+    elm_tls->gContext.layer_bytes  = 0;
+    elm_tls->gContext.layer_clock  = 0;
+    elm_tls->gContext.async_loads  = NULL;
+    elm_tls->gContext.scissor_enabled = FALSE;
 
 #if (RTOS && DDRLESS) || BAREMETAL
     for (i = 0; i < sizeof(elm_tls->gContext.objmap_ebo) / 4; i++) {
@@ -89,6 +96,11 @@ static int _initialize_elm(uint32_t width, uint32_t height)
     elm_tls->gContext.objcounter_evo = 0;
     elm_tls->gContext.objcounter_ebo = 0;
     elm_tls->gContext.objcounter_group = 0;
+
+    memset(elm_tls->gContext.objgen_grad, 0, sizeof(elm_tls->gContext.objgen_grad));
+    memset(elm_tls->gContext.objgen_evo, 0, sizeof(elm_tls->gContext.objgen_evo));
+    memset(elm_tls->gContext.objgen_ebo, 0, sizeof(elm_tls->gContext.objgen_ebo));
+    memset(elm_tls->gContext.objgen_group, 0, sizeof(elm_tls->gContext.objgen_group));
 #endif
     return 1;
 }
@@ -102,6 +114,7 @@ static void _terminate_vglite(void)
 /* Terminate elm global objects. */
 static void _terminate_elm(void)
 {
+    trim_layers(0);
 #if (VG_RENDER_TEXT==1)
     _release_default_text_parameters();
 #endif
@@ -45,6 +45,43 @@
  */
 
 #if (RTOS && DDRLESS) || BAREMETAL
+/* Slot of an object in a pool of count entries of size bytes, from its
+ * address, or -1 if it is not in the pool. The object's index can not be
+ * trusted: loaders clear the whole object after allocating it. */
+static int pool_slot(const void *pool, uint32_t count, uint32_t size, const void *object)
+{
+    uintptr_t offset = (uintptr_t)object - (uintptr_t)pool;
+
+    if (offset >= (uintptr_t)count * size || offset % size != 0)
+        return -1;
+
+    return (int)(offset / size);
+}
+
+#define POOL_SLOT(pool, object) \
+    pool_slot((pool), COUNT_OF(pool), sizeof((pool)[0]), (object))
+
+/* Count leading zeros of a 32-bit word, x must not be 0. */
+#if defined(__ICCARM__)
+#include <intrinsics.h>
+#define ELM_CLZ(x)  __CLZ(x)
+#elif defined(__GNUC__) || defined(__clang__)
+#define ELM_CLZ(x)  __builtin_clz(x)
+#else
+static int ELM_CLZ(uint32_t x)
+{
+    int n = 0;
+
+    if ((x & 0xffff0000) == 0) { n += 16; x <<= 16; }
+    if ((x & 0xff000000) == 0) { n += 8;  x <<= 8;  }
+    if ((x & 0xf0000000) == 0) { n += 4;  x <<= 4;  }
+    if ((x & 0xc0000000) == 0) { n += 2;  x <<= 2;  }
+    if ((x & 0x80000000) == 0) { n += 1; }
+
+    return n;
+}
+#endif
+
 /* Find some free objects, return the first index,
  * and mark the bits as 1 (allocated).
  * Params:
@@ -52,59 +89,62 @@
  * count   : the element count of free_map[];
  * obj_count:how many objects to allocate from the pool.
  *
+ * The map is scanned a run at a time: counting leading zeros of the remaining
+ * bits gives the length of a free run, counting leading ones skips an
+ * allocated run.
+ *
  * Return:
  *  The free index of the object in the pool.
  * */
 int get_free_objects(int32_t free_map[], int count, int obj_count)
 {
-    int i, j;
+    int i, pos, run;
     int result = -1;
     int counter = 0;
-    int bit_count = 0;
-    int32_t bits;
-
-    /* Find a free bit. */
-    for (i = 0; i < count; i++) {
-        bits = free_map[i];
-
-        for (j = 0; j < 32; j++) {
-            //Increase the bit counter.
-            bit_count++;
-
-            if ((bits & 0x80000000) == 0) {
-                //Free bit is found. then count available free bits.
-                counter++;
-            }
-            else {
-                //Free bit is not found, reset the counter.
+    int bit_count;
+    uint32_t bits;
+
+    /* Find a run of free bits. */
+    for (i = 0; i < count && result < 0; i++) {
+        pos = 0;
+        while (pos < 32) {
+            bits = (uint32_t)free_map[i] << pos;
+
+            if (bits & 0x80000000) {
+                //Allocated run: skip it and reset the counter.
+                //The bits shifted in at the bottom are 1 in ~bits, so the run stops at the word end.
+                run = (~bits == 0) ? 32 - pos : ELM_CLZ(~bits);
                 counter = 0;
             }
-
-            //Check to see whether enough bits are found.
-            if (counter >= obj_count) {
-                result = bit_count - counter;
-
-                //Get out of the two loops.
-                i = count;
-                break;
+            else {
+                //Free run: clip it to the end of the word.
+                run = (bits == 0) ? 32 - pos : ELM_CLZ(bits);
+                if (run > 32 - pos)
+                    run = 32 - pos;
+
+                //Check to see whether enough bits are found.
+                if (counter + run >= obj_count) {
+                    result = i * 32 + pos - counter;
+                    break;
+                }
+                counter += run;
             }
-
-            //Shift to next bit.
-            bits <<= 1;
+            pos += run;
         }
     }
 
     /* Mark the bits as allocated if OK. */
     if (result > -1) {
-        int bits_set = 1;
+        uint32_t bits_set;
         int bit_offset = result % 32;
         bit_count = result / 32;
 
         while (obj_count > 0) {
-            bits_set = ~(0xffffffff << (32 - bit_offset));
+            bits_set = 0xffffffff >> bit_offset;
             if (obj_count <= 32 - bit_offset) {
                 //Done.
-                bits_set = bits_set & (0xffffffff << (32 - bit_offset - obj_count));
+                if (bit_offset + obj_count < 32)
+                    bits_set &= ~(0xffffffff >> (bit_offset + obj_count));
                 free_map[bit_count] |= bits_set;
                 break;
             }
@@ -120,25 +160,30 @@ int get_free_objects(int32_t free_map[], int count, int obj_count)
     return result;
 }
 
-/* When an object is "freed", mark the corresponding bits to 0. */
-void mark_free_object(int32_t free_map[], int object)
+/* When an object is "freed", mark the corresponding bits to 0,
+ * and bump the slot generation so outstanding handles go stale. */
+void mark_free_object(int32_t free_map[], uint16_t generation[], int object)
 {
     int index, offset;
 
+    /* Not a pool object. */
+    if (object < 0)
+        return;
+
     index = object / 32;
     offset = object % 32;
 
-    free_map[index] &= ~(1 << (31 - offset));
+    free_map[index] &= ~(1u << (31 - offset));
+    generation[object] = (generation[object] + 1) & POOL_GEN_MASK;
 }
 
 /* Check whether an object (with given index) allocated or not. */
 int object_exists(int32_t free_map[], int index)
 {
-    int32_t bits;
+    uint32_t bits;
     int offset = index % 32;
     index /= 32;
-
-    bits = ~(1 << (31 - offset));
+    bits = 1u << (31 - offset);
 
     if (free_map[index] & bits) {
         return 1;
@@ -216,18 +261,6 @@ static el_Obj_Group * alloc_ego()
     return object;
 }
 
-/* Mark an EGO object as free: insert it into the free list. */
-static void free_ego(el_Obj_Group *object)
-{
-    elm_tls_t* elm_tls;
-    elm_tls = (elm_tls_t *) elm_os_get_tls();
-    if (elm_tls == NULL)
-        return NULL;
-
-    mark_free_object(elm_tls->gContext.objmap_group, elm_tls->object->object.index);
-    elm_tls->gContext.objcounter_group--;
-}
-
 /* Allocate a grad object from pool. */
 static el_Obj_Grad * alloc_grad()
 {
@@ -264,6 +297,70 @@ int ref_object(el_Object *object)
     return object->reference;
 }
 
+int destroy_object(ElmHandle handle);
+
+/* Get the EBO of an image name from the image cache, creating it on the first
+ * reference. Each successful call must be paired with release_image(). */
+ElmHandle acquire_image(const char *name)
+{
+    elm_tls_t* elm_tls;
+    el_ImageRef *entry, *free_entry = NULL;
+    ElmHandle handle;
+    int i;
+
+    elm_tls = (elm_tls_t *) elm_os_get_tls();
+    if (elm_tls == NULL || name == NULL || name[0] == '\0')
+        return ELM_NULL_HANDLE;
+
+    for (i = 0; i < IMAGE_CACHE_SIZE; i++) {
+        entry = &elm_tls->gContext.image_cache[i];
+        if (entry->reference == 0) {
+            if (free_entry == NULL)
+                free_entry = entry;
+        }
+        else if (strncmp(entry->name, name, sizeof(entry->name)) == 0) {
+            entry->reference++;
+            return entry->handle;
+        }
+    }
+
+    handle = ElmCreateObjectFromFile(ELM_OBJECT_TYPE_EBO, name);
+
+    /* When the cache is full the EBO is owned by the caller alone. */
+    if (handle != ELM_NULL_HANDLE && free_entry != NULL) {
+        strncpy(free_entry->name, name, sizeof(free_entry->name) - 1);
+        free_entry->name[sizeof(free_entry->name) - 1] = '\0';
+        free_entry->handle = handle;
+        free_entry->reference = 1;
+    }
+
+    return handle;
+}
+
+/* Drop a reference got from acquire_image(), the EBO is destroyed with the last one. */
+void release_image(ElmHandle handle)
+{
+    elm_tls_t* elm_tls;
+    el_ImageRef *entry;
+    int i;
+
+    elm_tls = (elm_tls_t *) elm_os_get_tls();
+    if (elm_tls == NULL || handle == ELM_NULL_HANDLE)
+        return;
+
+    for (i = 0; i < IMAGE_CACHE_SIZE; i++) {
+        entry = &elm_tls->gContext.image_cache[i];
+        if (entry->reference > 0 && entry->handle == handle) {
+            if (--entry->reference > 0)
+                return;
+            entry->handle = ELM_NULL_HANDLE;
+            break;
+        }
+    }
+
+    destroy_object(handle);
+}
+
 int add_object(el_Object *object)
 {
     elm_tls_t* elm_tls;
@@ -271,9 +368,35 @@ int add_object(el_Object *object)
     if (elm_tls == NULL)
         return 0;
 #if (RTOS && DDRLESS) || BAREMETAL
-    /* Assign handle. */
-    object->handle = elm_tls->gContext.currentHandle++;
-    return 1;
+    /* Assign handle: encode the pool, the slot and its current generation,
+     * so get_object() resolves it without searching. */
+    el_Context *context = &elm_tls->gContext;
+    int index;
+
+    index = POOL_SLOT(context->objpool_evo, object);
+    if (index >= 0) {
+        object->handle = POOL_HANDLE(ELM_POOL_EVO, context->objgen_evo[index], index);
+        return 1;
+    }
+    index = POOL_SLOT(context->objpool_ebo, object);
+    if (index >= 0) {
+        object->handle = POOL_HANDLE(ELM_POOL_EBO, context->objgen_ebo[index], index);
+        return 1;
+    }
+    index = POOL_SLOT(context->objpool_grad, object);
+    if (index >= 0) {
+        object->handle = POOL_HANDLE(ELM_POOL_GRAD, context->objgen_grad[index], index);
+        return 1;
+    }
+    index = POOL_SLOT(context->objpool_group, object);
+    if (index >= 0) {
+        object->handle = POOL_HANDLE(ELM_POOL_GROUP, context->objgen_group[index], index);
+        return 1;
+    }
+
+    /* Not a pool object, it could never be resolved. */
+    object->handle = ELM_NULL_HANDLE;
+    return 0;
 #else
     int result = 1;
     el_ObjList *list = NULL;
@@ -368,39 +491,56 @@ el_Object *get_object(ElmHandle handle)
         return NULL;
 
 #if (RTOS && DDRLESS) || BAREMETAL
-    int i;
-    for (i = 0; i < OBJCOUNT_EVO; i++) {
-        if (object_exists(elm_tls->gContext.objmap_evo, i)) {
-            if (elm_tls->gContext.objpool_evo[i].object.handle == handle) {
-                object = (el_Object *)&elm_tls->gContext.objpool_evo[i];
-                return object;
+    el_Context *context = &elm_tls->gContext;
+    int slot = POOL_HANDLE_SLOT(handle);
+    int32_t *map = NULL;
+    uint16_t *generation = NULL;
+
+    switch (POOL_HANDLE_POOL(handle)) {
+        case ELM_POOL_EVO:
+            if (slot < OBJCOUNT_EVO) {
+                object = &context->objpool_evo[slot].object;
+                map = context->objmap_evo;
+                generation = context->objgen_evo;
             }
-        }
-    }
-    for (i = 0; i < OBJCOUNT_EBO; i++) {
-        if (object_exists(elm_tls->gContext.objmap_ebo, i)) {
-            if (elm_tls->gContext.objpool_ebo[i].object.handle == handle) {
-                object = (el_Object *)&elm_tls->gContext.objpool_ebo[i];
-                return object;
+            break;
+
+        case ELM_POOL_EBO:
+            if (slot < OBJCOUNT_EBO) {
+                object = &context->objpool_ebo[slot].object;
+                map = context->objmap_ebo;
+                generation = context->objgen_ebo;
             }
-        }
-    }
-    for (i = 0; i < OBJCOUNT_GRAD; i++) {
-        if (object_exists(elm_tls->gContext.objmap_grad, i)) {
-            if (elm_tls->gContext.objpool_grad[i].object.handle == handle) {
-                object = (el_Object *)&elm_tls->gContext.objpool_grad[i];
-                return object;
+            break;
+
+        case ELM_POOL_GRAD:
+            if (slot < OBJCOUNT_GRAD) {
+                object = &context->objpool_grad[slot].object;
+                map = context->objmap_grad;
+                generation = context->objgen_grad;
             }
-        }
-    }
-    for (i = 0; i < OBJCOUNT_GROUP; i++) {
-        if (object_exists(elm_tls->gContext.objmap_group, i)) {
-            if (elm_tls->gContext.objpool_group[i].object.handle == handle) {
-                object = (el_Object *)&elm_tls->gContext.objpool_group[i];
-                return object;
+            break;
+
+        case ELM_POOL_GROUP:
+            if (slot < OBJCOUNT_GROUP) {
+                object = &context->objpool_group[slot].object;
+                map = context->objmap_group;
+                generation = context->objgen_group;
             }
-        }
+            break;
+
+        default:
+            break;
+    }
+
+    /* The slot must be allocated, of the same generation, and still carry the handle. */
+    if (object != NULL &&
+        object_exists(map, slot) &&
+        generation[slot] == POOL_HANDLE_GEN(handle) &&
+        object->handle == handle) {
+        return object;
     }
+    object = NULL;
 #else
     el_ObjList *list = NULL;
 
@@ -427,8 +567,9 @@ static void free_grad(el_Obj_Grad *object)
 {
     elm_tls_t* elm_tls;
     elm_tls = (elm_tls_t *) elm_os_get_tls();
-    if (elm_tls != NULL) {
-        mark_free_object(elm_tls->gContext.objmap_grad, object->object.index);
+    if (elm_tls != NULL && object != NULL) {
+        mark_free_object(elm_tls->gContext.objmap_grad, elm_tls->gContext.objgen_grad,
+                     POOL_SLOT(elm_tls->gContext.objpool_grad, object));
         elm_tls->gContext.objcounter_grad--;
     }
 }
@@ -442,8 +583,19 @@ int destroy_evo(el_Obj_EVO *evo)
     if (elm_tls == NULL)
         return 0;
 
+    /* Text objects are smaller, they have none of the EVO caches. */
+    if (evo->defaultAttrib.paint.type != ELM_PAINT_TEXT) {
+        if (evo->is_image && evo->ebo != ELM_NULL_HANDLE) {
+            release_image(evo->ebo);
+            evo->ebo = ELM_NULL_HANDLE;
+        }
+        free_pattern_texture(evo);
+        free_layer(&evo->layer);
+    }
+
 #if (RTOS && DDRLESS) || BAREMETAL
-    mark_free_object(elm_tls->gContext.objmap_evo, evo->object.index);
+    mark_free_object(elm_tls->gContext.objmap_evo, elm_tls->gContext.objgen_evo,
+                     POOL_SLOT(elm_tls->gContext.objpool_evo, evo));
     elm_tls->gContext.objcounter_evo--;
     free_grad(evo->defaultAttrib.paint.grad);
 #else
@@ -464,7 +616,8 @@ int destroy_evo(el_Obj_EVO *evo)
 
     if (evo->data.path.path != NULL) {
         vg_lite_clear_path(&evo->data.path);
-        elm_free(evo->data.path.path);
+        if (!evo->mapped)
+            elm_free(evo->data.path.path);
         evo->data.path.path = NULL;
     }
     }
@@ -486,8 +639,18 @@ int destroy_ego(el_Obj_Group *ego)
     if(elm_tls == NULL)
         return 0;
 
+    free_layer(&ego->layer);
+    free_hit_index(&ego->hit_index);
+    free_group_transforms(&ego->xf);
+
 #if (RTOS && DDRLESS) || BAREMETAL
-    mark_free_object(elm_tls->gContext.objmap_group, ego->object.index);
+    int i;
+    for (i = 0; i < ego->group.count; i++)
+    {
+        destroy_evo(&ego->group.objects[i]);
+    }
+    mark_free_object(elm_tls->gContext.objmap_group, elm_tls->gContext.objgen_group,
+                     POOL_SLOT(elm_tls->gContext.objpool_group, ego));
     elm_tls->gContext.objcounter_group--;
 #else
     int i;
@@ -514,7 +677,8 @@ int destroy_ebo(el_Obj_EBO *ebo)
         return 0;
 
 #if (RTOS && DDRLESS) || BAREMETAL
-    mark_free_object(elm_tls->gContext.objmap_ebo, ebo->object.index);
+    mark_free_object(elm_tls->gContext.objmap_ebo, elm_tls->gContext.objgen_ebo,
+                     POOL_SLOT(elm_tls->gContext.objpool_ebo, ebo));
     elm_tls->gContext.objcounter_ebo--;
 #else
     if ( ebo != NULL && ebo->data.buffer.handle != NULL) {
@@ -598,6 +762,21 @@ static el_Obj_EVO* _get_evo(el_Obj_Group *group, int32_t id)
     }
 }
 
+/* Record a change for the retained scene graph. A group child marks itself
+ * and its group, a group transform marks the group only. */
+static void _mark_dirty(el_Obj_Group *group, el_Obj_EVO *evo, uint32_t bits)
+{
+    if (evo != NULL) {
+        evo->dirty |= bits;
+        if (group != NULL) {
+            group->dirty |= ELM_DIRTY_CHILD;
+        }
+    }
+    else if (group != NULL) {
+        group->dirty |= bits;
+    }
+}
+
 #if (VG_RENDER_TEXT==1)
 static int _load_font(uint8_t *data,
                       unsigned size)
@@ -637,7 +816,77 @@ static ElmHandle _load_text(uint8_t *data,
 #pragma diag_suppress = Pa039
 #endif
 
-static ElmHandle _load_evo(const uint8_t *data, unsigned size, el_Obj_EVO *evo)
+#if !((RTOS && DDRLESS) || BAREMETAL)
+/* Rewrite an FP32 or S32 path in place as S16 when every coordinate is a
+ * 16-bit integer, halving what the GPU fetches per draw. Opcodes take one
+ * coordinate slot, as in the object files. Returns the new length, or 0 if
+ * the path is left as it was. */
+static uint32_t _compact_path(uint8_t *path, uint32_t length, vg_lite_format_t format)
+{
+    static const uint8_t coord_count[] = { 0, 0, 2, 2, 2, 2, 4, 4, 6, 6 };
+    uint32_t pass, offset = 0, out = 0, n, k;
+    int32_t value;
+    int16_t value16;
+    float valuef;
+    uint8_t op;
+
+    if (format != VG_LITE_FP32 && format != VG_LITE_S32)
+        return 0;
+
+    /* Check every coordinate, then convert: the data is overwritten from the
+     * start, behind the read position. */
+    for (pass = 0; pass < 2; pass++) {
+        offset = out = 0;
+        while (offset + 4 <= length) {
+            op = path[offset];
+            if (op >= COUNT_OF(coord_count))
+                return 0;    /* Arcs are only in arc paths, not compacted. */
+            n = coord_count[op];
+            if (offset + 4 + n * 4 > length)
+                return 0;
+
+            if (pass == 1) {
+                path[out] = op;
+                path[out + 1] = 0;
+            }
+            offset += 4;
+            out += 2;
+
+            for (k = 0; k < n; k++, offset += 4, out += 2) {
+                if (format == VG_LITE_FP32) {
+                    memcpy(&valuef, path + offset, sizeof(valuef));
+                    if (!(valuef >= -32768.0f && valuef <= 32767.0f) ||
+                        valuef != (float)(int32_t)valuef)
+                        return 0;
+                    value = (int32_t)valuef;
+                }
+                else {
+                    memcpy(&value, path + offset, sizeof(value));
+                    if (value < -32768 || value > 32767)
+                        return 0;
+                }
+
+                if (pass == 1) {
+                    value16 = (int16_t)value;
+                    memcpy(path + out, &value16, sizeof(value16));
+                }
+            }
+
+            if (op == VLC_OP_END)
+                break;
+        }
+    }
+
+    return out;
+}
+#endif
+
+/* Load an EVO. With ELM_LOAD_IN_PLACE the path data, and gradient colors when
+ * aligned, are referenced from data, which must outlive the object. With
+ * ELM_LOAD_DEFERRED the handle is left pending and the object returned in
+ * loaded, for _publish_object. */
+static ElmHandle _load_evo(const uint8_t *data, unsigned size, el_Obj_EVO *evo,
+                           uint32_t flags, el_Object **loaded)
 {
     int i = 0;
 #if (RTOS && DDRLESS) || BAREMETAL
@@ -646,6 +895,7 @@ static ElmHandle _load_evo(const uint8_t *data, unsigned size, el_Obj_EVO *evo)
 #else
     uint32_t *colors = NULL;
     uint8_t *path_data = NULL;
+    BOOL colors_mapped = FALSE;
 #endif
     el_Obj_EVO *local_evo = NULL;
     el_EVO_Header *evo_header = (el_EVO_Header *) data;
@@ -684,7 +934,7 @@ static ElmHandle _load_evo(const uint8_t *data, unsigned size, el_Obj_EVO *evo)
                       error_exit);
         memcpy(evo->eboname,
                evo_header->image.eboname,
-               evo_header->image.namelength);
+               MIN(evo_header->image.namelength, sizeof(evo->eboname) - 1));
         evo->is_image = evo_header->image.paint_type.is_image;
         _init_transform(&evo->defaultAttrib.transform);
         memcpy(&evo->defaultAttrib.transform.matrix,
@@ -706,23 +956,45 @@ static ElmHandle _load_evo(const uint8_t *data, unsigned size, el_Obj_EVO *evo)
         el_Transform *grad_transform = NULL;
         el_EVO_Polygon *object_data = (el_EVO_Polygon *) &(evo_header->polygon);
         el_EVO_GradData *grad_data = (el_EVO_GradData *) &(evo_header->polygon.grad);
+        vg_lite_format_t path_format = (vg_lite_format_t) object_data->format;
+        uint32_t path_length = object_data->length;
+
+        /* Check the path data is within the object. */
+        JUMP_IF_LOWER(size,
+                      object_data->offset + object_data->length,
+                      error_exit);
 
         /* Get path data from the object. */
 #if (RTOS && DDRLESS) || BAREMETAL
         path_data = (void *) (data + object_data->offset);
+        evo->mapped = TRUE;
 #else
-        path_data = (uint8_t *)elm_alloc(1, object_data->length);
-        JUMP_IF_NULL(path_data, error_exit);
+        if ((flags & ELM_LOAD_IN_PLACE) && ((uintptr_t)(data + object_data->offset) & 3) == 0) {
+            /* Reference the path data where it is, e.g. in XIP flash. */
+            path_data = (uint8_t *)(data + object_data->offset);
+            evo->mapped = TRUE;
+        }
+        else {
+            path_data = (uint8_t *)elm_alloc(1, object_data->length);
+            JUMP_IF_NULL(path_data, error_exit);
 
 #ifdef ENABLE_STRICT_DEBUG_MEMSET
-        memset(path_data, 0, object_data->length);
+            memset(path_data, 0, object_data->length);
 #endif
-        JUMP_IF_LOWER(size,
-                      object_data->offset + object_data->length,
-                      error_exit);
-        /* Get path data. */
-        memcpy(path_data, (void *)(data + object_data->offset),
-               object_data->length);
+            /* Get path data. */
+            memcpy(path_data, (void *)(data + object_data->offset),
+                   object_data->length);
+
+            /* The loader task has time to spare for shrinking the path. */
+            if ((flags & ELM_LOAD_DEFERRED) && !object_data->arc_flag) {
+                uint32_t compact_length = _compact_path(path_data, object_data->length,
+                                                        (vg_lite_format_t) object_data->format);
+                if (compact_length != 0) {
+                    path_format = VG_LITE_S16;
+                    path_length = compact_length;
+                }
+            }
+        }
 #endif
 
         if(object_data->paint_type.has_pattern)
@@ -756,11 +1028,31 @@ static ElmHandle _load_evo(const uint8_t *data, unsigned size, el_Obj_EVO *evo)
             grad_transform = &evo->defaultAttrib.paint.grad->data.transform;
             memcpy(&grad_transform->matrix, &(grad_data->matrix),
                    sizeof(vg_lite_matrix_t));
-            colors = (uint32_t *)elm_alloc(grad_data->stop_count, sizeof(uint32_t));
-            JUMP_IF_NULL(colors, error_exit);
+            JUMP_IF_LOWER(size,
+                          grad_data->color_offset + grad_data->stop_count * sizeof(uint32_t),
+                          error_exit);
+            JUMP_IF_LOWER(size,
+                          grad_data->stop_offset + grad_data->stop_count * sizeof(float),
+                          error_exit);
+#if (RTOS && DDRLESS) || BAREMETAL
+            JUMP_IF_GREATER(grad_data->stop_count, VLC_MAX_GRAD, error_exit);
             memcpy(colors,
                    data + grad_data->color_offset,
                    grad_data->stop_count * sizeof(uint32_t));
+#else
+            if ((flags & ELM_LOAD_IN_PLACE) && ((uintptr_t)(data + grad_data->color_offset) & 3) == 0) {
+                /* The ramp is built from the colors in place. */
+                colors = (uint32_t *)(data + grad_data->color_offset);
+                colors_mapped = TRUE;
+            }
+            else {
+                colors = (uint32_t *)elm_alloc(grad_data->stop_count, sizeof(uint32_t));
+                JUMP_IF_NULL(colors, error_exit);
+                memcpy(colors,
+                       data + grad_data->color_offset,
+                       grad_data->stop_count * sizeof(uint32_t));
+            }
+#endif
         }
 
         if (object_data->arc_flag)
@@ -775,9 +1067,9 @@ static ElmHandle _load_evo(const uint8_t *data, unsigned size, el_Obj_EVO *evo)
                                  object_data->max_y);
         else
           vg_lite_init_path(&evo->data.path,
-                            (vg_lite_format_t) object_data->format,
+                            path_format,
                             (vg_lite_quality_t) object_data->quality,
-                            object_data->length,
+                            path_length,
                             path_data,
                             object_data->min_x,
                             object_data->min_y,
@@ -873,22 +1165,30 @@ static ElmHandle _load_evo(const uint8_t *data, unsigned size, el_Obj_EVO *evo)
         evo->defaultAttrib.paint.color = object_data->color;
         evo->attribute = evo->defaultAttrib;
         ref_object(&evo->object);
-        JUMP_IF_NON_ZERO_VALUE(add_object(&evo->object), error_exit);
+        if (flags & ELM_LOAD_DEFERRED) {
+            evo->object.handle = ELM_PENDING_HANDLE;
+        }
+        else {
+            JUMP_IF_NON_ZERO_VALUE(add_object(&evo->object), error_exit);
+        }
 
 #if (RTOS && DDRLESS) || BAREMETAL
 #else
-        elm_free(colors);
+        if (!colors_mapped)
+            elm_free(colors);
 #endif
     }
 
+    if (loaded != NULL)
+        *loaded = &evo->object;
     return evo->object.handle;
 
 error_exit:
 #if (RTOS && DDRLESS) || BAREMETAL
 #else
-    if ( colors != NULL )
+    if ( colors != NULL && !colors_mapped )
         elm_free(colors);
-    if ( path_data != NULL)
+    if ( path_data != NULL && (evo == NULL || !evo->mapped) )
         elm_free(path_data);
 #endif
 
@@ -902,7 +1202,8 @@ error_exit:
     return ELM_NULL_HANDLE;
 }
 
-static ElmHandle _load_ebo(const uint8_t *data, int size, uint32_t version)
+static ElmHandle _load_ebo(const uint8_t *data, int size, uint32_t version,
+                           uint32_t flags, el_Object **loaded)
 {
     vg_lite_error_t error;
     vg_lite_buffer_t *buffer;
@@ -1014,8 +1315,15 @@ static ElmHandle _load_ebo(const uint8_t *data, int size, uint32_t version)
     ebo->attribute = ebo->defaultAttrib;
 
     ref_object(&ebo->object);
-    JUMP_IF_NON_ZERO_VALUE(add_object(&ebo->object), error_exit);
+    if (flags & ELM_LOAD_DEFERRED) {
+        ebo->object.handle = ELM_PENDING_HANDLE;
+    }
+    else {
+        JUMP_IF_NON_ZERO_VALUE(add_object(&ebo->object), error_exit);
+    }
 
+    if (loaded != NULL)
+        *loaded = &ebo->object;
     return ebo->object.handle;
 
 error_exit:
@@ -1026,7 +1334,8 @@ error_exit:
     return ELM_NULL_HANDLE;
 }
 
-static ElmHandle _load_ego(const uint8_t *data, int size)
+static ElmHandle _load_ego(const uint8_t *data, int size,
+                           uint32_t flags, el_Object **loaded)
 {
     int i;
     unsigned int invalid_count = 0;
@@ -1043,6 +1352,13 @@ static ElmHandle _load_ego(const uint8_t *data, int size)
 #ifdef ENABLE_STRICT_DEBUG_MEMSET
     memset(ego, 0, sizeof(el_Obj_Group));
 #endif
+    ego->group.objects = NULL;
+    memset(&ego->xf, 0, sizeof(ego->xf));
+
+    /* The header and the size/offset tables must be within the data. */
+    JUMP_IF_LOWER(size, (int)sizeof(el_EGO_Header), error_exit);
+    JUMP_IF_LOWER((size - sizeof(el_EGO_Header)) / (2 * sizeof(uint32_t)),
+                  ego_header->count, error_exit);
 
     ego->object.type = (ELM_OBJECT_TYPE) ego_header->type;
     ego->object.reference = 0;
@@ -1058,9 +1374,8 @@ static ElmHandle _load_ego(const uint8_t *data, int size)
     ego->group.objects = (el_Obj_EVO *)elm_alloc(1, ego->group.count * sizeof(el_Obj_EVO));
 #endif
     JUMP_IF_NULL(ego->group.objects, error_exit);
-#ifdef ENABLE_STRICT_DEBUG_MEMSET
+    /* Text children do not fill their whole slot, keep the EVO caches clear. */
     memset(ego->group.objects, 0, ego->group.count * sizeof(el_Obj_EVO));
-#endif
 
     obj_size = (uint32_t *)((unsigned)data + sizeof(el_EGO_Header));
     obj_offset = (uint32_t *)((unsigned)obj_size + \
@@ -1083,7 +1398,9 @@ static ElmHandle _load_ego(const uint8_t *data, int size)
             case ELM_OBJECT_TYPE_EVO:
                 ego->group.objects[i].object.handle = _load_evo(obj_data,
                         obj_size[i],
-                        &ego->group.objects[i]);
+                        &ego->group.objects[i],
+                        flags,
+                        NULL);
                 break;
 #if (VG_RENDER_TEXT==1)
             case ELM_OBJECT_TYPE_FONT:
@@ -1101,15 +1418,30 @@ static ElmHandle _load_ego(const uint8_t *data, int size)
     }
 
     ego->group.count -= invalid_count;
+    JUMP_IF_NON_ZERO_VALUE(alloc_group_transforms(&ego->xf, ego->group.count), error_exit);
     ego->transform = ego->defaultTrans;
+    ego->dirty = ELM_DIRTY_TRANSFORM;
+    ego->cache_hint = FALSE;
+    ego->layer = NULL;
+    ego->hit_index = NULL;
+    memset(ego->damage, 0, sizeof(ego->damage));
+    ego->damage_serial = 0;
 
     ref_object(&ego->object);
-    JUMP_IF_NON_ZERO_VALUE(add_object(&ego->object), error_exit);
+    if (flags & ELM_LOAD_DEFERRED) {
+        ego->object.handle = ELM_PENDING_HANDLE;
+    }
+    else {
+        JUMP_IF_NON_ZERO_VALUE(add_object(&ego->object), error_exit);
+    }
 
+    if (loaded != NULL)
+        *loaded = &ego->object;
     return ego->object.handle;
 
 error_exit:
     if (ego != NULL ) {
+        free_group_transforms(&ego->xf);
         if ( ego->group.objects != NULL ) {
             elm_free(ego->group.objects);
         }
@@ -1177,6 +1509,7 @@ static BOOL _scale(ElmHandle obj, float x, float y)
 
     // Clean dirty.
     transform->dirty = FALSE;
+    _mark_dirty(ego, evo, ELM_DIRTY_TRANSFORM);
 
     return TRUE;
 }
@@ -1213,7 +1546,7 @@ static BOOL _reset_attrib(ElmHandle obj, ELM_EVO_PROP_BIT mask)
                 defaultTrans = &ego->defaultTrans;
             }
             else {
-                evo = _get_evo((el_Obj_Group*)obj, elm_tls->gContext.vector_id);
+                evo = _get_evo(ego, elm_tls->gContext.vector_id);
                 if (evo != NULL) {
                     attrib = &evo->attribute;
                     defaultAttr = &evo->defaultAttrib;
@@ -1282,6 +1615,14 @@ static BOOL _reset_attrib(ElmHandle obj, ELM_EVO_PROP_BIT mask)
         attrib->paint.type = defaultAttr->paint.type;
     }
 
+    if (mask & (ELM_PROP_ROTATE_BIT | ELM_PROP_TRANSFER_BIT | ELM_PROP_SCALE_BIT)) {
+        _mark_dirty(ego, evo, ELM_DIRTY_TRANSFORM);
+    }
+    if (mask & (ELM_PROP_BLEND_BIT | ELM_PROP_QUALITY_BIT | ELM_PROP_FILL_BIT |
+                ELM_PROP_COLOR_BIT | ELM_PROP_PAINT_BIT)) {
+        _mark_dirty(ego, evo, ELM_DIRTY_PAINT);
+    }
+
     return TRUE;
 }
 
@@ -1326,6 +1667,7 @@ static BOOL _set_quality(ElmHandle obj, ELM_QUALITY quality)
     }
 
     attrib->quality = quality;
+    _mark_dirty(group, evo, ELM_DIRTY_PAINT);
 
     return TRUE;
 }
@@ -1340,6 +1682,9 @@ static BOOL _set_fill(ElmVecObj evo, ELM_EVO_FILL fill)
     }
 
     object->attribute.fill_rule = fill;
+    if (object->object.type == ELM_OBJECT_TYPE_EVO) {
+        _mark_dirty(NULL, object, ELM_DIRTY_PAINT);
+    }
 
     return TRUE;
 }
@@ -1385,6 +1730,7 @@ static BOOL _set_blend(ElmHandle obj, ELM_BLEND blend)
     }
 
     attrib->blend = blend;
+    _mark_dirty(group, evo, ELM_DIRTY_PAINT);
 
     return TRUE;
 }
@@ -1423,6 +1769,7 @@ static BOOL _set_color(ElmVecObj evo, uint32_t color)
     }
 
     object->attribute.paint.color = color;
+    _mark_dirty(group, object, ELM_DIRTY_PAINT);
 
     return TRUE;
 }
@@ -1462,6 +1809,7 @@ static BOOL _set_pattern(ElmVecObj evo, ElmBitmapObj pattern)
 
     object->attribute.paint.pattern.pattern = ebo_obj;
     ref_object((el_Object *)ebo_obj);
+    _mark_dirty(group, object, ELM_DIRTY_PAINT);
 
     return TRUE;
 }
@@ -1499,6 +1847,7 @@ static BOOL _set_pattern_mode(ElmVecObj evo, ELM_PATTERN_MODE mode, uint32_t col
 
     object->attribute.paint.pattern.mode = mode;
     object->attribute.paint.pattern.color = color;
+    _mark_dirty(group, object, ELM_DIRTY_PAINT);
 
     return TRUE;
 }
@@ -1534,6 +1883,7 @@ static BOOL _set_paintType(ElmVecObj evo, ELM_PAINT_TYPE type)
     }
 
     object->attribute.paint.type = type;
+    _mark_dirty(group, object, ELM_DIRTY_PAINT);
 
     return TRUE;
 }
@@ -1591,6 +1941,7 @@ static BOOL _rotate(ElmHandle obj, float angle)
 
     // Clean dirty.
     transform->dirty = FALSE;
+    _mark_dirty(ego, evo, ELM_DIRTY_TRANSFORM);
 
     return TRUE;
 }
@@ -1648,6 +1999,7 @@ static BOOL _translate(ElmHandle obj, float x, float y)
 
     // Clean dirty.
     transform->dirty = FALSE;
+    _mark_dirty(ego, evo, ELM_DIRTY_TRANSFORM);
 
     return TRUE;
 }
@@ -1677,7 +2029,8 @@ static BOOL _verify_header(ELM_OBJECT_TYPE *type, uint32_t *version, void *data)
 /*
  Load the specified object from the data.
  */
-static ElmHandle _create_object_from_data(ELM_OBJECT_TYPE type, void *data, int size)
+static ElmHandle _create_object_from_data(ELM_OBJECT_TYPE type, void *data, int size,
+                                          uint32_t flags, el_Object **loaded)
 {
     ELM_OBJECT_TYPE real_type;
     uint32_t p_data = (uint32_t)data;
@@ -1699,17 +2052,18 @@ static ElmHandle _create_object_from_data(ELM_OBJECT_TYPE type, void *data, int
 
     /* Jump over the version field to get to the start of the first ELM object */
     data = (void *)((unsigned)data + sizeof(uint32_t));
+    size -= sizeof(uint32_t);
 
     switch (real_type) {
         case ELM_OBJECT_TYPE_EVO:
-            return _load_evo(data, size, NULL);
+            return _load_evo(data, size, NULL, flags, loaded);
             break;
 
         case ELM_OBJECT_TYPE_EGO:
-            return _load_ego(data, size);
+            return _load_ego(data, size, flags, loaded);
 
         case ELM_OBJECT_TYPE_EBO:
-            return _load_ebo(data, size, version);
+            return _load_ebo(data, size, version, flags, loaded);
 #if (VG_RENDER_TEXT==1)
         case ELM_OBJECT_TYPE_FONT:
             return _load_font(data, size);
@@ -1725,6 +2079,108 @@ static ElmHandle _create_object_from_data(ELM_OBJECT_TYPE type, void *data, int
     return ELM_NULL_HANDLE;
 }
 
+/* Give an object loaded with ELM_LOAD_DEFERRED, and the children of a group,
+ * their handles. If that fails, every handle handed out so far is withdrawn
+ * and the object destroyed. */
+static ElmHandle _publish_object(el_Object *object)
+{
+    el_Obj_Group *ego = NULL;
+    int i, published = 0;
+
+    /* The group first, so a failure rolls it back with its children. */
+    JUMP_IF_NON_ZERO_VALUE(add_object(object), error_exit);
+
+    if (object->type == ELM_OBJECT_TYPE_EGO) {
+        ego = (el_Obj_Group *)object;
+
+        for (; published < ego->group.count; published++) {
+            el_Object *child = &ego->group.objects[published].object;
+
+            if (child->handle == ELM_PENDING_HANDLE) {
+                JUMP_IF_NON_ZERO_VALUE(add_object(child), error_exit);
+            }
+        }
+    }
+
+    return object->handle;
+
+error_exit:
+    if (ego != NULL) {
+        for (i = 0; i < published; i++) {
+            remove_object(&ego->group.objects[i].object);
+            ego->group.objects[i].object.handle = ELM_NULL_HANDLE;
+        }
+    }
+    remove_object(object);
+    object->handle = ELM_NULL_HANDLE;
+
+    switch (object->type) {
+        case ELM_OBJECT_TYPE_EVO:
+            destroy_evo((el_Obj_EVO *)object);
+            elm_free(object);
+            break;
+
+        case ELM_OBJECT_TYPE_EGO:
+            destroy_ego((el_Obj_Group *)object);
+            break;
+
+        case ELM_OBJECT_TYPE_EBO:
+            destroy_ebo((el_Obj_EBO *)object);
+            break;
+
+        default:
+            break;
+    }
+
+    return ELM_NULL_HANDLE;
+}
+
+/* Whether an EGO holds text or fonts, which are loaded on the render task. */
+static BOOL _ego_has_text(const uint8_t *data, int size)
+{
+#if (VG_RENDER_TEXT==1)
+    unsigned int i;
+    const el_EGO_Header *ego_header = (const el_EGO_Header *) data;
+    const uint32_t *obj_size, *obj_offset, *obj_type;
+
+    /* A bad table is rejected by _load_ego anyway. */
+    if (size < (int)sizeof(el_EGO_Header) ||
+        (size - sizeof(el_EGO_Header)) / (2 * sizeof(uint32_t)) < ego_header->count)
+        return FALSE;
+
+    obj_size = (const uint32_t *)(data + sizeof(el_EGO_Header));
+    obj_offset = obj_size + ego_header->count;
+
+    for (i = 0; i < ego_header->count; i++) {
+        if (obj_size[i] < sizeof(uint32_t) || obj_offset[i] + obj_size[i] > size)
+            continue;
+
+        obj_type = (const uint32_t *)(data + obj_offset[i]);
+        if (*obj_type == ELM_OBJECT_TYPE_TEXT || *obj_type == ELM_OBJECT_TYPE_FONT)
+            return TRUE;
+    }
+#endif
+
+    return FALSE;
+}
+
+/* Loader task side of ElmCreateObjectAsync. */
+static void _async_load(void *arg)
+{
+    el_AsyncLoad *load = (el_AsyncLoad *)arg;
+    el_Object *object = NULL;
+
+    /* Only for the context checks of the shared helpers: deferred loading
+     * neither adds handles nor touches the object lists. */
+    elm_os_set_tls(load->tls);
+    _create_object_from_data(load->type, load->data, load->size,
+                             ELM_LOAD_DEFERRED, &object);
+    elm_os_reset_tls();
+
+    load->object = object;
+    load->done   = TRUE;
+}
+
 static el_Transform *_get_paint_transform(ElmHandle handle)
 {
     elm_tls_t* elm_tls;
@@ -1812,7 +2268,7 @@ ElmHandle ElmCreateObjectFromFile(ELM_OBJECT_TYPE type, const char *name)
             fseek(fp, 0, SEEK_SET);
             fread(data, size, 1, fp);
 
-            handle = _create_object_from_data(type, data, size);
+            handle = _create_object_from_data(type, data, size, 0, NULL);
         }
         else {
             printf("open %s failed!\n", name);
@@ -1848,7 +2304,163 @@ ElmHandle ElmCreateObjectFromFile(ELM_OBJECT_TYPE type, const char *name)
  */
 ElmHandle ElmCreateObjectFromData(ELM_OBJECT_TYPE type, void *data, int size)
 {
-    return _create_object_from_data(type, data, size);
+    return _create_object_from_data(type, data, size, 0, NULL);
+}
+
+/*!
+ @abstract Create an elementary object referencing read-only data in place.
+
+ @discussion
+ Same as ElmCreateObjectFromData, except that the EVO path data and gradient
+ colors are referenced where they are instead of being copied, so only the
+ mutable object state is allocated. The data can be in XIP flash or a memory
+ mapped file, and must stay valid and unchanged until the object is destroyed.
+ Misaligned blobs are still copied.
+
+ @param type
+ Specify what type of object to be created.
+
+ @param data
+ The pointer to the binary data which has exactly same layout as external resource file.
+
+ @param size
+ The size of the data in bytes.
+
+ @return ElmHandle
+ An object handle depending on the corresponding type. If type mismatches with the binary data, it
+ returns ELM_NULL_HANDLE.
+ */
+ElmHandle ElmCreateObjectFromMappedData(ELM_OBJECT_TYPE type, const void *data, int size)
+{
+    return _create_object_from_data(type, (void *)data, size, ELM_LOAD_IN_PLACE, NULL);
+}
+
+/*!
+ @abstract Create an elementary object in the background.
+
+ @discussion
+ The data is parsed, and the paths and gradient ramps built, on the low
+ priority loader task, which also stores integer paths as S16; the handle is only assigned by ElmPollAsync on the
+ rendering task, which then invokes the callback. Groups with text, text and
+ font objects, and builds without a loader task are loaded synchronously here
+ and reported on the next ElmPollAsync. The data must stay valid until the
+ callback has been invoked.
+
+ @param type
+ Specify what type of object to be created.
+
+ @param data
+ The pointer to the binary data which has exactly same layout as external resource file.
+
+ @param size
+ The size of the data in bytes.
+
+ @param callback
+ The function to call with the new handle, it may be NULL.
+
+ @return BOOL
+ If the load was queued.
+ */
+BOOL ElmCreateObjectAsync(ELM_OBJECT_TYPE type, void *data, int size, ElmLoadCallback callback)
+{
+    elm_tls_t* elm_tls;
+    el_AsyncLoad *load, **tail;
+    BOOL deferred = FALSE;
+
+    elm_tls = (elm_tls_t *) elm_os_get_tls();
+    if (elm_tls == NULL || data == NULL || size < (int)(2 * sizeof(uint32_t)))
+        return FALSE;
+
+    load = (el_AsyncLoad *)elm_alloc(1, sizeof(el_AsyncLoad));
+    if (load == NULL)
+        return FALSE;
+
+    load->type     = type;
+    load->data     = data;
+    load->size     = size;
+    load->callback = callback;
+    load->tls      = elm_tls;
+    load->object   = NULL;
+    load->handle   = ELM_NULL_HANDLE;
+    load->done     = FALSE;
+    load->next     = NULL;
+
+    tail = &elm_tls->gContext.async_loads;
+    while (*tail != NULL) {
+        tail = &(*tail)->next;
+    }
+    *tail = load;
+
+#if (RTOS && DDRLESS) || BAREMETAL
+    /* Pool objects are allocated from the context, keep it on this task. */
+#else
+    {
+        ELM_OBJECT_TYPE real_type;
+
+        _verify_header(&real_type, NULL, data);
+        switch (real_type) {
+            case ELM_OBJECT_TYPE_EVO:
+            case ELM_OBJECT_TYPE_EBO:
+                deferred = TRUE;
+                break;
+
+            case ELM_OBJECT_TYPE_EGO:
+                deferred = !_ego_has_text((uint8_t *)data + sizeof(uint32_t),
+                                          size - sizeof(uint32_t));
+                break;
+
+            default:
+                break;
+        }
+    }
+#endif
+
+    if (deferred && elm_os_queue_work(_async_load, load) == VG_LITE_SUCCESS)
+        return TRUE;
+
+    load->handle = _create_object_from_data(type, data, size, 0, NULL);
+    load->done   = TRUE;
+
+    return TRUE;
+}
+
+/*!
+ @abstract Publish the objects loaded in the background.
+
+ @discussion
+ Assigns the handles of the finished ElmCreateObjectAsync loads and invokes
+ their callbacks. Call it from the rendering task, e.g. once per frame.
+
+ @return uint32_t
+ The number of loads still in progress.
+ */
+uint32_t ElmPollAsync(void)
+{
+    elm_tls_t* elm_tls;
+    el_AsyncLoad *load, **link;
+    uint32_t pending = 0;
+
+    elm_tls = (elm_tls_t *) elm_os_get_tls();
+    if (elm_tls == NULL)
+        return 0;
+
+    link = &elm_tls->gContext.async_loads;
+    while ((load = *link) != NULL) {
+        if (!load->done) {
+            pending++;
+            link = &load->next;
+            continue;
+        }
+
+        *link = load->next;
+        if (load->object != NULL)
+            load->handle = _publish_object(load->object);
+        if (load->callback != NULL)
+            load->callback(load->handle, load->data);
+        elm_free(load);
+    }
+
+    return pending;
 }
 
 /*!
@@ -2120,6 +2732,64 @@ BOOL ElmSetPaintType(ElmVecObj evo, ELM_PAINT_TYPE type)
     return _set_paintType(evo, type);
 }
 
+/*!
+ @abstract Hint that a group, or a group child, is static and worth caching.
+
+ @discussion
+ A hinted group is rendered once into an offscreen layer and composited with
+ one blit per frame, until its content or transform changes. When the current
+ vector (ElmSetCurrentVector) is set, only that child is hinted; consecutive
+ hinted children share one layer.
+
+ @param obj
+ The group object.
+
+ @param enable
+ Cache the object or not.
+
+ @return bool
+ The operation is successful or not.
+ */
+BOOL ElmSetCacheHint(ElmHandle obj, BOOL enable)
+{
+#if !DDRLESS
+    elm_tls_t* elm_tls;
+    el_Object *object;
+    el_Obj_Group *ego;
+    el_Obj_EVO *evo;
+    int i;
+
+    elm_tls = (elm_tls_t *) elm_os_get_tls();
+    if (elm_tls == NULL)
+        return FALSE;
+
+    object = get_object(obj);
+    if (object == NULL || object->type != ELM_OBJECT_TYPE_EGO)
+        return FALSE;
+
+    ego = (el_Obj_Group *)object;
+    if (elm_tls->gContext.vector_id < 0) {
+        ego->cache_hint = enable;
+        free_layer(&ego->layer);
+    }
+    else {
+        evo = _get_evo(ego, elm_tls->gContext.vector_id);
+        if (evo == NULL)
+            return FALSE;
+        evo->cache_hint = enable;
+
+        /* The hinted ranges changed, drop their layers. */
+        for (i = 0; i < ego->group.count; i++) {
+            free_layer(&ego->group.objects[i].layer);
+        }
+    }
+
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
 /*!
  @abstract Get the solid fill color of an evo object.
 
@@ -2,6 +2,22 @@
 #if !defined(_BAREMETAL) && !defined(ONE_TASK_SUPPORT)
 #include "FreeRTOS.h"
 #include "task.h"
+#include "queue.h"
+
+#ifndef ELM_WORKER_PRIORITY
+#define ELM_WORKER_PRIORITY     (tskIDLE_PRIORITY + 1)
+#endif
+#ifndef ELM_WORKER_STACK_SIZE
+#define ELM_WORKER_STACK_SIZE   1024
+#endif
+#define ELM_WORKER_QUEUE_LENGTH 8
+
+typedef struct {
+    elm_os_work_t   work;
+    void           *arg;
+} elm_os_work_item_t;
+
+static QueueHandle_t work_queue = NULL;
 
 vg_lite_error_t elm_os_set_tls(void* tls)
 {
@@ -20,6 +36,46 @@ void elm_os_reset_tls(void)
 {
     vTaskSetThreadLocalStoragePointer(NULL, 1, NULL);
 }
+
+static void elm_os_worker(void *param)
+{
+    elm_os_work_item_t item;
+
+    (void)param;
+    for (;;) {
+        if (xQueueReceive(work_queue, &item, portMAX_DELAY) == pdTRUE) {
+            item.work(item.arg);
+        }
+    }
+}
+
+vg_lite_error_t elm_os_queue_work(elm_os_work_t work, void *arg)
+{
+    elm_os_work_item_t item;
+
+    if (work == NULL)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    /* The loader task is created on first use. */
+    if (work_queue == NULL) {
+        work_queue = xQueueCreate(ELM_WORKER_QUEUE_LENGTH, sizeof(elm_os_work_item_t));
+        if (work_queue == NULL)
+            return VG_LITE_OUT_OF_MEMORY;
+        if (xTaskCreate(elm_os_worker, "elm_loader", ELM_WORKER_STACK_SIZE, NULL,
+                        ELM_WORKER_PRIORITY, NULL) != pdPASS) {
+            vQueueDelete(work_queue);
+            work_queue = NULL;
+            return VG_LITE_OUT_OF_RESOURCES;
+        }
+    }
+
+    item.work = work;
+    item.arg  = arg;
+    if (xQueueSend(work_queue, &item, 0) != pdTRUE)
+        return VG_LITE_OUT_OF_RESOURCES;
+
+    return VG_LITE_SUCCESS;
+}
 #else
 
 static void* pTLS;
@@ -41,4 +97,11 @@ void elm_os_reset_tls(void)
 {
     pTLS = (void*)0;
 }
+
+vg_lite_error_t elm_os_queue_work(elm_os_work_t work, void *arg)
+{
+    (void)work;
+    (void)arg;
+    return VG_LITE_NOT_SUPPORT;
+}
 #endif
\ No newline at end of file
@@ -10,4 +10,9 @@ void * elm_os_get_tls(void);
 
 void elm_os_reset_tls(void);
 
+typedef void (*elm_os_work_t)(void *arg);
+
+/* Run work(arg) on the low priority loader task, VG_LITE_NOT_SUPPORT without one. */
+vg_lite_error_t elm_os_queue_work(elm_os_work_t work, void *arg);
+
 #endif
\ No newline at end of file
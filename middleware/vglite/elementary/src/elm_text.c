@@ -184,62 +184,75 @@ static int get_property(font_field_info_t *dst_font_fields, font_fields_t *src_f
     return 0;
 }
 
-vg_lite_error_t draw_text(el_Obj_Buffer *buff, 
-                                 el_Obj_EVO *evo, vg_lite_matrix_t *mat)
+/* Find the font of a text object, falls back to the default font.
+   vg_lite_find_font remembers its results, so this is cheap to repeat */
+static vg_lite_font_t resolve_text_font(el_Obj_TEXT *text)
 {
-    vg_lite_error_t error = VG_LITE_INVALID_ARGUMENT;
-    el_Obj_TEXT *text = (el_Obj_TEXT *)evo;
-    vg_lite_blend_t blend = (vg_lite_blend_t)text->attribute.blend;
-    vg_lite_font_t curr_font = VG_LITE_INVALID_FONT;
-    int curr_font_attrib_idx = INVALID_FONT_PROPERTY_IDX;
-
-    vg_lite_font_attributes_t *font_attribs = &g_font_attribs;
+    vg_lite_font_t font = VG_LITE_INVALID_FONT;
     font_field_info_t *font_fields = NULL;
 
-    curr_font_attrib_idx = text->font_id;
-
-    /* Single font caching can be done here (No caching for now)
-       Release last font object if it is different
-     */
-    if ( vg_lite_is_font_valid(g_last_font) == 1 ) {
-      /* recycle font objects */
-      vg_lite_free_font_memory(g_last_font);
-      g_last_font = VG_LITE_INVALID_FONT;
-    }
-
-    if(curr_font_attrib_idx != INVALID_FONT_PROPERTY_IDX)
+    if(text->font_id != INVALID_FONT_PROPERTY_IDX &&
+       text->font_id < g_total_system_font)
     {
-        font_fields = &g_font_properties[curr_font_attrib_idx][0];
-        font_fields[eFontHeightProperty].value.i_value = text->font_size;
+        font_fields = &g_font_properties[text->font_id][0];
+        text->font_height = text->font_size;
 
-        curr_font = vg_lite_find_font(
+        font = vg_lite_find_font(
             font_fields[eFontNameProperty].value.data,
             (eFontWeight_t)font_fields[eFontWeightProperty].value.i_value,
             (eFontStretch_t)font_fields[eFontStretchProperty].value.i_value,
             (eFontStyle_t)font_fields[eFontStyleProperty].value.i_value,
-            font_fields[eFontHeightProperty].value.i_value
-            );
+            text->font_height);
     }
 
-    if (curr_font == VG_LITE_INVALID_FONT) {
-        //printf("ERROR: Font not found. Rendering with default configuration\n");
+    /* Without a font id the default font is the requested one. */
+    text->font_fallback = (font == VG_LITE_INVALID_FONT &&
+                           text->font_id != INVALID_FONT_PROPERTY_IDX);
+    if (font == VG_LITE_INVALID_FONT) {
         font_fields = &g_default_font_properties[0];
-            curr_font = vg_lite_find_font(
-                font_fields[eFontNameProperty].value.data,
-                (eFontWeight_t)font_fields[eFontWeightProperty].value.i_value,
-                (eFontStretch_t)font_fields[eFontStretchProperty].value.i_value,
-                (eFontStyle_t)font_fields[eFontStyleProperty].value.i_value,
-                font_fields[eFontHeightProperty].value.i_value);
+        text->font_height = font_fields[eFontHeightProperty].value.i_value;
+        font = vg_lite_find_font(
+            font_fields[eFontNameProperty].value.data,
+            (eFontWeight_t)font_fields[eFontWeightProperty].value.i_value,
+            (eFontStretch_t)font_fields[eFontStretchProperty].value.i_value,
+            (eFontStyle_t)font_fields[eFontStyleProperty].value.i_value,
+            text->font_height);
     }
-    if (curr_font == VG_LITE_INVALID_FONT) {
+    if (font == VG_LITE_INVALID_FONT) {
         printf("Font[%s] not found\n", font_fields[eFontNameProperty].value.data);
+    }
+
+    text->font = font;
+    return font;
+}
+
+vg_lite_error_t draw_text(el_Obj_Buffer *buff, 
+                                 el_Obj_EVO *evo, vg_lite_matrix_t *mat)
+{
+    vg_lite_error_t error = VG_LITE_INVALID_ARGUMENT;
+    el_Obj_TEXT *text = (el_Obj_TEXT *)evo;
+    vg_lite_blend_t blend = (vg_lite_blend_t)text->attribute.blend;
+    vg_lite_font_t curr_font = text->font;
+
+    vg_lite_font_attributes_t *font_attribs = &g_font_attribs;
+
+    /* Loaded fonts stay resident across draws, the driver unloads
+       fonts that are not in use only when its font budget is exceeded */
+
+    /* Font is resolved when the text is loaded. Until the requested font
+       is found, look it up again on each draw so fonts registered later
+       are picked up here */
+    if (text->font_fallback || vg_lite_is_font_valid(curr_font) != 0) {
+        curr_font = resolve_text_font(text);
+    }
+    if (curr_font == VG_LITE_INVALID_FONT) {
         return VG_LITE_INVALID_ARGUMENT;
     }
     font_attribs->is_vector_font = vg_lite_is_vector_font(curr_font);
     /* Properties that changes over time */
     font_attribs->text_color = text->attribute.paint.color;
     font_attribs->alignment = (eTextAlign_t)text->text_anchor;
-    font_attribs->font_height = font_fields[eFontHeightProperty].value.i_value;
+    font_attribs->font_height = text->font_height;
     font_attribs->tspan_has_dx_dy = text->tspan_has_dx_dy;
 
     error = vg_lite_draw_text(&buff->buffer,
@@ -251,7 +264,7 @@ vg_lite_error_t draw_text(el_Obj_Buffer *buff,
                font_attribs);
 
     g_last_font = curr_font;
-    g_last_font_attrib_idx = curr_font_attrib_idx;
+    g_last_font_attrib_idx = text->font_id;
     return error;
 }
 
@@ -579,6 +592,7 @@ ElmHandle _load_text_data(uint8_t *data, el_Obj_EVO *evo)
     evo_text->font_id           = (int)text_header->font_id;
     evo_text->font_size         = (int)text_header->font_size;
     evo_text->msg               = text_data;
+    resolve_text_font(evo_text);
 
     evo_text->defaultAttrib.quality = (ELM_QUALITY)VG_LITE_HIGH;
     evo_text->defaultAttrib.fill_rule = ELM_EVO_FILL_NZ;
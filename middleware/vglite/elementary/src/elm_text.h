@@ -28,6 +28,7 @@
 *****************************************************************************/
 #include "Elm.h"
 #include "velm.h"
+#include "vg_lite_text.h"
 
 #ifndef _elm_text_h_
 #define _elm_text_h_
@@ -170,6 +171,9 @@ typedef struct {
     uint32_t            text_anchor;
     uint32_t            font_size;
     uint32_t            font_id;
+    vg_lite_font_t      font;           /* Resolved when the text is loaded */
+    uint32_t            font_fallback;  /* font is the default one, the requested font was not found */
+    uint32_t            font_height;
     uint32_t            x_pos;
     uint32_t            y_pos;
     unsigned char       *msg;
@@ -47,11 +47,52 @@ extern "C" {
 #define RTOS 1
 #endif
 #define APP_BUFFER_COUNT 2
+#define IMAGE_CACHE_SIZE 16
+
+/* Dirty bits of the retained scene graph nodes. */
+#define ELM_DIRTY_TRANSFORM 0x1 /* The node transform changed. */
+#define ELM_DIRTY_PAINT     0x2 /* Color, blend, fill, quality or paint changed. */
+#define ELM_DIRTY_CHILD     0x4 /* A child of the group is dirty. */
+
+/* Frames of damage a group keeps, the most buffers in flight ElmDrawDamaged supports. */
+#define DAMAGE_HISTORY      4
+
+/* Default memory budget of the layer cache (ElmSetCacheHint). */
+#define LAYER_CACHE_BUDGET  (1024 * 1024)
+
+/* Largest ElmHitTest grid, in cells per side. */
+#define HIT_GRID_MAX        32
+/* Segments a curve is flattened into by the exact ElmHitTest test. */
+#define HIT_CURVE_SEGMENTS  16
+
+/* Object loader flags. */
+#define ELM_LOAD_IN_PLACE   0x1 /* Reference the path data and colors in the blob. */
+#define ELM_LOAD_DEFERRED   0x2 /* Leave the handle to _publish_object (loader task). */
+
+/* Handle of an object loaded but not published yet. */
+#define ELM_PENDING_HANDLE  ((ElmHandle)~0u)
 #if (RTOS && DDRLESS) || BAREMETAL
 #define OBJCOUNT_GRAD    16
 #define    OBJCOUNT_EVO    128
 #define OBJCOUNT_EBO    64
 #define OBJCOUNT_GROUP    16
+
+/* Pool object handles.
+ * [31:28] pool type (never 0, so a valid handle is never ELM_NULL_HANDLE);
+ * [27:16] generation of the pool slot, bumped every time the slot is freed;
+ * [15:0]  slot index in the pool.
+ * */
+#define ELM_POOL_EVO     1
+#define ELM_POOL_EBO     2
+#define ELM_POOL_GRAD    3
+#define ELM_POOL_GROUP   4
+
+#define POOL_GEN_MASK    0xfff
+#define POOL_HANDLE(pool, gen, slot) \
+    ((ElmHandle)(((pool) << 28) | (((gen) & POOL_GEN_MASK) << 16) | ((slot) & 0xffff)))
+#define POOL_HANDLE_POOL(handle)    (((handle) >> 28) & 0xf)
+#define POOL_HANDLE_GEN(handle)     (((handle) >> 16) & POOL_GEN_MASK)
+#define POOL_HANDLE_SLOT(handle)    ((handle) & 0xffff)
 #endif
 
 #if RTOS
@@ -213,8 +254,15 @@ typedef enum {
         uint32_t            is_pattern;
         uint32_t            is_image;
         char                eboname[20];
+        ElmHandle           ebo;        /* The cached EBO of eboname, resolved on first draw. */
         uint32_t            img_width;
         uint32_t            img_height;
+        vg_lite_buffer_t   *pattern_texture;    /* Cached rendering of the pattern children (has_pattern). */
+        uint32_t            pattern_signature;  /* State of the pattern children it was rendered from. */
+        uint32_t            dirty;              /* ELM_DIRTY_* bits since the node was last drawn. */
+        BOOL                mapped;             /* The path data is referenced in place, not owned. */
+        BOOL                cache_hint;         /* Cache this child, with its hinted neighbours, in a layer. */
+        struct el_Layer    *layer;              /* The layer of the hinted range this child starts. */
     } el_Obj_EVO;
 
     /*!
@@ -247,6 +295,27 @@ typedef enum {
         el_Obj_EVO *        objects;
     } el_GroupData;
 
+    /*!
+     @typedef el_GroupTransforms
+     The transform state of the children of a group, kept as a structure of
+     arrays so that group wide updates stream through contiguous memory.
+     Entry k = row * 3 + column of the matrix of child i is m[k][i].
+     !local             Child matrices
+     !world             Group matrix times child matrix, or the child matrix alone when own
+     !box               Child bounding boxes in child coordinates: left, top, right, bottom
+     !bounds            Child bounding boxes under world
+     !own               The child is placed by its own matrix only (image nodes)
+     !valid             local, box and own hold the state of all the children
+     */
+    typedef struct {
+        float              *local[9];
+        float              *world[9];
+        float              *box[4];
+        float              *bounds[4];
+        uint8_t            *own;
+        BOOL                valid;
+    } el_GroupTransforms;
+
     /*!
      @typedef el_Obj_Group
      Group object type definition.
@@ -256,6 +325,15 @@ typedef enum {
         el_Transform        transform;
         el_Transform        defaultTrans;
         el_GroupData        group;
+        el_GroupTransforms  xf;                 /* World matrices and bounds of the children. */
+        uint32_t            dirty;              /* ELM_DIRTY_* bits since the group was last drawn. */
+        float               bounds[4];          /* Union of the children world bounds. */
+        BOOL                cache_hint;         /* Cache the whole group in a layer. */
+        struct el_Layer    *layer;
+        float               damage[4];          /* Area changed since the last ElmDrawDamaged. */
+        uint32_t            damage_serial;      /* Count of ElmDrawDamaged frames of the group. */
+        float               damage_history[DAMAGE_HISTORY][4]; /* Damage of the last frames. */
+        struct el_HitIndex *hit_index;          /* Spatial index of ElmHitTest, built on first use. */
     } el_Obj_Group;
 
     /*!
@@ -265,8 +343,64 @@ typedef enum {
     typedef struct {
         el_Object           object;
         vg_lite_buffer_t    buffer;
+        ElmHandle           damage_object;      /* The object last drawn with ElmDrawDamaged. */
+        uint32_t            damage_serial;      /* Its damage serial at that time. */
     } el_Obj_Buffer;
 
+    /*!
+     @typedef el_Layer
+     An offscreen rendering of a cached group or range of group children.
+     !target            The offscreen buffer, usable as a render target
+     !x, y              Position of the layer in the render target
+     !target_width      Width of the render target it was clipped to
+     !target_height     Height of the render target it was clipped to
+     !size              Bytes counted against the layer budget
+     !last_used         LRU stamp
+     !valid             The content matches the cached nodes
+     !owner             The node field pointing to this layer
+     */
+    typedef struct el_Layer {
+        el_Obj_Buffer       target;
+        int32_t             x;
+        int32_t             y;
+        int32_t             target_width;
+        int32_t             target_height;
+        uint32_t            size;
+        uint32_t            last_used;
+        BOOL                valid;
+        struct el_Layer   **owner;
+        struct el_Layer    *next;
+    } el_Layer;
+
+    /*!
+     @typedef el_HitIndex
+     Uniform grid over the world bounds of the children of a group. Each cell
+     lists the children overlapping it in drawing order, followed by spare room
+     so that moved children are re-filed without rebuilding the grid.
+     !bounds            The area of the grid, outside children are filed in the border cells
+     !scale_x, scale_y  Cells per pixel
+     !cols, rows        Size of the grid
+     !count             Count of group children
+     !cell_start        First item of each cell, cols * rows + 1 entries
+     !cell_count        Items used in each cell
+     !spans             Cells of each child: first column, first row, last column, last row
+     !items             Child indices
+     !valid             The grid matches the children, rebuilt when cleared
+     */
+    typedef struct el_HitIndex {
+        float               bounds[4];
+        float               scale_x;
+        float               scale_y;
+        uint32_t            cols;
+        uint32_t            rows;
+        uint32_t            count;
+        uint32_t           *cell_start;
+        uint16_t           *cell_count;
+        uint8_t           (*spans)[4];
+        uint16_t           *items;
+        BOOL                valid;
+    } el_HitIndex;
+
     /*!
      @typedef el_ObjList
      List to organize objects.
@@ -285,6 +419,42 @@ typedef enum {
         vg_lite_buffer_t *buffer;
     } ElmRenderBuffer;
 
+    /*!
+     @typedef el_ImageRef
+     An entry of the image cache, which shares one EBO among all the EVO
+     image nodes referring to the same image name.
+     !name              The image name
+     !handle            The EBO handle
+     !reference         Count of EVO image nodes holding the EBO
+     */
+    typedef struct {
+        char                name[20];
+        ElmHandle           handle;
+        int                 reference;
+    } el_ImageRef;
+
+    /*!
+     @typedef el_AsyncLoad
+     A load requested by ElmCreateObjectAsync.
+     !data              The object data
+     !callback          Called with the handle once published
+     !tls               The Elementary context of the requesting task
+     !object            The loaded object, waiting for a handle
+     !handle            The handle, if the object was loaded synchronously
+     !done              Set by the loader task when object is ready
+     */
+    typedef struct el_AsyncLoad {
+        ELM_OBJECT_TYPE     type;
+        void               *data;
+        int                 size;
+        ElmLoadCallback     callback;
+        void               *tls;
+        el_Object * volatile object;
+        ElmHandle           handle;
+        volatile BOOL       done;
+        struct el_AsyncLoad *next;
+    } el_AsyncLoad;
+
     /*!
      @typedef el_Context
      The context object for global data management.
@@ -300,6 +470,20 @@ typedef enum {
         unsigned int        objectCount;
         el_ObjList         *object_slots[SLOT_COUNT];
         ElmRenderBuffer     elmFB[APP_BUFFER_COUNT];
+        el_ImageRef         image_cache[IMAGE_CACHE_SIZE];
+
+        /* Layer cache. */
+        el_Layer           *layers;
+        uint32_t            layer_budget;
+        uint32_t            layer_bytes;
+        uint32_t            layer_clock;
+
+        /* Loads of ElmCreateObjectAsync, in request order. */
+        el_AsyncLoad       *async_loads;
+
+        /* Scissor of ElmDrawDamaged, lifted while rendering offscreen. */
+        BOOL                scissor_enabled;
+        int32_t             scissor[4];
         /* VGLite related states. */
         uint32_t            tessellation_width;
         uint32_t            tessellation_height;
@@ -328,6 +512,14 @@ typedef enum {
         int        objcounter_evo;
         int        objcounter_ebo;
         int        objcounter_group;
+
+        /* The generation of each pool slot, encoded into the object handles
+         * so stale handles to a reused slot are rejected by get_object().
+         * */
+        uint16_t       objgen_grad[OBJCOUNT_GRAD];
+        uint16_t       objgen_evo[OBJCOUNT_EVO];
+        uint16_t       objgen_ebo[OBJCOUNT_EBO];
+        uint16_t       objgen_group[OBJCOUNT_GROUP];
 #endif
     } el_Context;
 
@@ -345,6 +537,14 @@ typedef enum {
     int         add_object      (el_Object     *object);
     int         remove_object   (el_Object     *object);
     el_Object  *get_object      (ElmHandle      handle);
+    ElmHandle   acquire_image   (const char    *name);
+    void        release_image   (ElmHandle      handle);
+    void        free_pattern_texture(el_Obj_EVO *evo);
+    void        free_layer      (el_Layer     **owner);
+    void        trim_layers     (uint32_t       budget);
+    void        free_hit_index  (el_HitIndex  **index);
+    BOOL        alloc_group_transforms(el_GroupTransforms *xf, uint32_t count);
+    void        free_group_transforms (el_GroupTransforms *xf);
 
 #ifdef __cplusplus
 }
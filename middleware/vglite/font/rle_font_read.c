@@ -45,6 +45,29 @@
 #define RCD_ALLOC(x) _mem_allocate(x)
 #define RCD_FREE(x) _mem_free(x)
 
+/* Map dictionary and glyph tables of RCD fonts directly from the
+ * registered font data (e.g. XIP flash) instead of copying them to RAM.
+ * The font data must then stay valid while the font is registered,
+ * as it already has to for vector fonts. */
+#ifndef RCD_LOAD_IN_PLACE
+#define RCD_LOAD_IN_PLACE 1
+#endif
+
+/* Heap bytes loaded fonts may keep after they are released. Fonts that are
+ * not in use stay loaded until this budget is exceeded, then the least
+ * recently used ones are unloaded. */
+#ifndef VG_LITE_FONT_RESIDENCY_BUDGET
+#define VG_LITE_FONT_RESIDENCY_BUDGET (64 * 1024)
+#endif
+
+/* Buckets of the font index, a power of two above MAX_SYSTEM_FONTS */
+#define FONT_INDEX_SIZE (2 * MAX_SYSTEM_FONTS)
+
+/* Remembered vg_lite_find_font results */
+#ifndef VG_LITE_FONT_MATCH_CACHE_SIZE
+#define VG_LITE_FONT_MATCH_CACHE_SIZE 16
+#endif
+
 #ifdef ENABLE_DEBUG_TRACE
 static int g_id;
 
@@ -78,16 +101,47 @@ typedef struct font_info_internal {
   struct mf_font_s *_raster_font;
   /* Internal loaded vector font */
   font_face_desc_t *_vector_font;
+  /* Residency of loaded font data */
+  int ref_count;
+  int resident_size;
+  uint32_t last_used;
+  /* Hash of the interned family name */
+  uint32_t name_hash;
 }font_info_internal_t;
 
+/* Memoized vg_lite_find_font query */
+typedef struct font_match {
+  char font_name_list[MAX_FONT_NAME_LEN];
+  uint32_t hash;
+  int8_t weight;
+  int8_t stretch;
+  int8_t style;
+  int8_t valid;
+  int font_height;
+  vg_lite_font_t font;
+}font_match_t;
+
+/* Loaded raster font, tables may point into the font data */
+typedef struct rle_font_desc {
+  struct mf_rlefont_s rle_font;
+  const char *data;
+  int data_len;
+}rle_font_desc_t;
+
 /** Internal or external API prototypes */
 
 /** Globals */
 static font_info_internal_t s_device_fonts[MAX_SYSTEM_FONTS];
+static int s_font_budget = VG_LITE_FONT_RESIDENCY_BUDGET;
+static uint32_t s_font_use_stamp;
+/* Font handles hashed by family and, for raster fonts, face properties */
+static int8_t s_font_index[FONT_INDEX_SIZE];
+static font_match_t s_font_matches[VG_LITE_FONT_MATCH_CACHE_SIZE];
 
 /** Local function prototypes */
 int read_rle_font_header(bufferred_reader_t *f, struct mf_font_s* font);
 int read_rle_font_from_buffer(char *buf, int size, struct mf_font_s* font);
+int map_rle_font_from_buffer(char *buf, int size, struct mf_font_s* font);
 int load_raster_font(char *data, int data_len, struct mf_font_s** font);
 
 int read_8b(bufferred_reader_t *f, uint8_t* pdata);
@@ -98,8 +152,10 @@ int read_8b_blob(bufferred_reader_t *f, uint8_t** ary, uint32_t* ary_len);
 int free_rle_font_memory(struct mf_font_s** font);
 vg_lite_error_t vg_lite_free_font_memory(vg_lite_font_t font);
 vg_lite_error_t vg_lite_load_font_data(vg_lite_font_t font, int font_height);
+static vg_lite_error_t _load_font_data(vg_lite_font_t font, int font_height);
 
 /** Externs if any */
+extern int g_total_bytes;
 
 /** Code section */
 vg_lite_font_t vg_lite_find_font(
@@ -109,6 +165,90 @@ vg_lite_font_t vg_lite_find_font(
     eFontStyle_t   font_style,
     int font_height);
 
+/* Hash of a font family name of len characters */
+static uint32_t font_name_hash(const char *name, int len)
+{
+  uint32_t hash = 2166136261u; /* FNV-1a */
+
+  while (len-- > 0) {
+    hash ^= (uint8_t)*name++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/* Index key, vector fonts are scalable and only keyed by family */
+static uint32_t font_index_key(uint32_t name_hash, int is_vector,
+    eFontWeight_t weight, eFontStretch_t stretch, eFontStyle_t style,
+    int height)
+{
+  if (is_vector)
+    return name_hash;
+
+  name_hash ^= ((uint32_t)weight << 24) ^ ((uint32_t)stretch << 16) ^
+               ((uint32_t)style << 8) ^ (uint32_t)height;
+  return name_hash * 16777619u;
+}
+
+/* Rebuild font index after the registered fonts changed */
+static void rebuild_font_index(void)
+{
+  vg_lite_font_params_t *params;
+  uint32_t slot;
+  int i;
+
+  memset(s_font_index, VG_LITE_INVALID_FONT, sizeof(s_font_index));
+  for (i=0; i<MAX_SYSTEM_FONTS; i++) {
+    if (s_device_fonts[i].valid != 1)
+      continue;
+    params = &s_device_fonts[i].font_params;
+    slot = font_index_key(s_device_fonts[i].name_hash,
+                          params->font_type == eFontTypeVector,
+                          params->font_weight, params->font_stretch,
+                          params->font_style, params->font_height);
+    slot &= FONT_INDEX_SIZE - 1;
+    while (s_font_index[slot] != VG_LITE_INVALID_FONT)
+      slot = (slot + 1) & (FONT_INDEX_SIZE - 1);
+    s_font_index[slot] = (int8_t)i;
+  }
+
+  /* Remembered matches may resolve differently now */
+  memset(s_font_matches, 0, sizeof(s_font_matches));
+}
+
+/* Look up one family name of len characters in the font index */
+static vg_lite_font_t lookup_font(const char *name, int len,
+    eFontWeight_t weight, eFontStretch_t stretch, eFontStyle_t style,
+    int height)
+{
+  vg_lite_font_params_t *params;
+  uint32_t name_hash = font_name_hash(name, len);
+  uint32_t slot;
+  int is_vector;
+  int probes;
+  int font;
+
+  for (is_vector = 0; is_vector < 2; is_vector++) {
+    slot = font_index_key(name_hash, is_vector, weight, stretch, style,
+                          height) & (FONT_INDEX_SIZE - 1);
+    for (probes = 0; probes < FONT_INDEX_SIZE &&
+         (font = s_font_index[slot]) != VG_LITE_INVALID_FONT; probes++) {
+      params = &s_device_fonts[font].font_params;
+      if (s_device_fonts[font].name_hash == name_hash &&
+          (params->font_type == eFontTypeVector) == is_vector &&
+          strncmp(params->name, name, len) == 0 && params->name[len] == '\0' &&
+          s_device_fonts[font].valid == 1 &&
+          (is_vector ||
+           (params->font_weight == weight && params->font_stretch == stretch &&
+            params->font_style == style && params->font_height == height)))
+        return font;
+      slot = (slot + 1) & (FONT_INDEX_SIZE - 1);
+    }
+  }
+
+  return VG_LITE_INVALID_FONT;
+}
+
 vg_lite_error_t vg_lite_register_font(vg_lite_font_t *font, 
     vg_lite_font_params_t *params)
 {
@@ -147,7 +287,13 @@ vg_lite_error_t vg_lite_register_font(vg_lite_font_t *font,
   } else {
       /* Add new font in global table */
       memcpy(&s_device_fonts[free_entry].font_params, params, sizeof(vg_lite_font_params_t));
+      s_device_fonts[free_entry].ref_count = 0;
+      s_device_fonts[free_entry].resident_size = 0;
+      s_device_fonts[free_entry].name_hash = font_name_hash(
+          s_device_fonts[free_entry].font_params.name,
+          strlen(s_device_fonts[free_entry].font_params.name));
       s_device_fonts[free_entry].valid = 1;
+      rebuild_font_index();
 /* 
    Loading font here leads to low run-time memory, we may need to characterize memory usage 
    e.g. pure path test don't require font, eventhrough application registers them
@@ -197,6 +343,7 @@ vg_lite_error_t vg_lite_unregister_font(vg_lite_font_t font)
 
     vg_lite_free_font_memory(font);
     s_device_fonts[font].valid = 0;
+    rebuild_font_index();
     return VG_LITE_SUCCESS;
 }
 
@@ -224,15 +371,91 @@ vg_lite_error_t vg_lite_free_font_memory(vg_lite_font_t font)
       break;
     case eFontTypeRaster:
       if ( s_device_fonts[font]._raster_font != NULL ) {
+          /* Layouts and atlas refer to glyphs of the font being freed */
+          vg_lite_flush_text_layouts(font);
+          vg_lite_destroy_glyph_atlas(font);
           free_rle_font_memory(&s_device_fonts[font]._raster_font);
           s_device_fonts[font]._raster_font = NULL;
       }
       break;
   }
+  s_device_fonts[font].resident_size = 0;
   
   return VG_LITE_SUCCESS;
 }
 
+static int is_font_loaded(vg_lite_font_t font)
+{
+  if (s_device_fonts[font].font_params.font_type == eFontTypeVector)
+    return s_device_fonts[font]._vector_font != NULL;
+  return s_device_fonts[font]._raster_font != NULL;
+}
+
+/* Unload least recently used fonts nobody holds until the loaded fonts
+ * fit into budget bytes. */
+static void trim_fonts(int budget, vg_lite_font_t keep)
+{
+  int total;
+  int victim;
+  int i;
+
+  while (1) {
+    total = 0;
+    victim = VG_LITE_INVALID_FONT;
+    for (i=0; i<MAX_SYSTEM_FONTS; i++) {
+      if ( s_device_fonts[i].valid != 1 || !is_font_loaded(i) )
+        continue;
+      total += s_device_fonts[i].resident_size;
+      if ( i == keep || s_device_fonts[i].ref_count > 0 )
+        continue;
+      if ( victim == VG_LITE_INVALID_FONT ||
+           s_device_fonts[i].last_used < s_device_fonts[victim].last_used )
+        victim = i;
+    }
+    if ( total <= budget || victim == VG_LITE_INVALID_FONT )
+      return;
+    vg_lite_free_font_memory(victim);
+  }
+}
+
+vg_lite_error_t vg_lite_acquire_font(vg_lite_font_t font, int font_height)
+{
+  vg_lite_error_t error;
+
+  error = vg_lite_load_font_data(font, font_height);
+  if ( error != VG_LITE_SUCCESS ) {
+      return error;
+  }
+  s_device_fonts[font].ref_count++;
+
+  return VG_LITE_SUCCESS;
+}
+
+vg_lite_error_t vg_lite_release_font(vg_lite_font_t font)
+{
+  if ( vg_lite_is_font_valid(font) != 0 ||
+       s_device_fonts[font].ref_count <= 0 ) {
+        return VG_LITE_INVALID_ARGUMENT;
+  }
+  /* Font data stays loaded until it is evicted for the budget,
+   * the font released last is the last one to go */
+  s_device_fonts[font].ref_count--;
+  trim_fonts(s_font_budget, font);
+
+  return VG_LITE_SUCCESS;
+}
+
+void vg_lite_set_font_budget(int bytes)
+{
+  s_font_budget = bytes;
+  trim_fonts(s_font_budget, VG_LITE_INVALID_FONT);
+}
+
+void vg_lite_trim_font_memory(void)
+{
+  trim_fonts(0, VG_LITE_INVALID_FONT);
+}
+
 font_face_desc_t *_vg_lite_get_vector_font(vg_lite_font_t font)
 {
   if ( vg_lite_is_font_valid(font) != 0 ) {
@@ -251,13 +474,41 @@ struct mf_font_s *_vg_lite_get_raster_font(vg_lite_font_t font)
   return s_device_fonts[font]._raster_font;
 }
 
+/* Load font data, fonts nobody holds are unloaded once if memory runs out */
 vg_lite_error_t vg_lite_load_font_data(vg_lite_font_t font, int font_height)
 {
+  vg_lite_error_t error;
+  int heap_bytes;
+
   if ( vg_lite_is_font_valid(font) != 0 ) {
         /* Font not found */
         return VG_LITE_INVALID_ARGUMENT;
   }
 
+  s_device_fonts[font].last_used = ++s_font_use_stamp;
+  if ( is_font_loaded(font) ) {
+      return VG_LITE_SUCCESS;
+  }
+
+  heap_bytes = g_total_bytes;
+  error = _load_font_data(font, font_height);
+  if ( error == VG_LITE_OUT_OF_MEMORY ) {
+      trim_fonts(0, font);
+      heap_bytes = g_total_bytes;
+      error = _load_font_data(font, font_height);
+  }
+  if ( error == VG_LITE_SUCCESS && is_font_loaded(font) ) {
+      s_device_fonts[font].resident_size = g_total_bytes - heap_bytes;
+      trim_fonts(s_font_budget, font);
+  }
+
+  return error;
+}
+
+static vg_lite_error_t _load_font_data(vg_lite_font_t font, int font_height)
+{
+  int ret;
+
   switch (s_device_fonts[font].font_params.font_type) {
     case eFontTypeVector:
       if (s_device_fonts[font]._vector_font == NULL ) {
@@ -278,12 +529,13 @@ vg_lite_error_t vg_lite_load_font_data(vg_lite_font_t font, int font_height)
           //       s_device_fonts[font].font_params.name);
           /* Raster fonts height should match */
           if ( font_height == s_device_fonts[font].font_params.font_height &&
-              load_raster_font(
+              (ret = load_raster_font(
                  s_device_fonts[font].font_params.data,
                  s_device_fonts[font].font_params.data_len,
-                 &s_device_fonts[font]._raster_font) != 0)
+                 &s_device_fonts[font]._raster_font)) != 0)
           {
-              return VG_LITE_INVALID_ARGUMENT;
+              return (ret == VG_LITE_OUT_OF_MEMORY) ?
+                     VG_LITE_OUT_OF_MEMORY : VG_LITE_INVALID_ARGUMENT;
           }
       }
       return VG_LITE_SUCCESS;
@@ -299,85 +551,56 @@ vg_lite_font_t vg_lite_find_font(
     eFontStyle_t   font_style,
     int font_height)
 {
-    int i;
-    char tmp_data;
-    int font_found = 0;
-    int end_pos = 0; /* End position of font name */
-    char *font_name;
-    /*
-    printf("Font params: [%s],%d, %d, %d, %d\n",
-           font_name_list,
-           font_weight,
-           font_stretch,
-           font_style,
-           font_height);
-    */
-    
-    /* While probing font, if required font is found, then
-       only keep that name in supplied font list */
-    
-    /* Split and extract font name one-by-one */
+    font_match_t *match;
+    vg_lite_font_t font = VG_LITE_INVALID_FONT;
+    const char *font_name;
+    uint32_t hash;
+    int list_len;
+    int len;
+
+    if (font_name_list == NULL)
+        return VG_LITE_INVALID_FONT;
+
+    /* Same query as before resolves without touching the font table */
+    list_len = strlen(font_name_list);
+    hash = font_index_key(font_name_hash(font_name_list, list_len), 0,
+                          font_weight, font_stretch, font_style, font_height);
+    match = &s_font_matches[hash % VG_LITE_FONT_MATCH_CACHE_SIZE];
+    if (match->valid && match->hash == hash &&
+        match->weight == font_weight && match->stretch == font_stretch &&
+        match->style == font_style && match->font_height == font_height &&
+        strcmp(match->font_name_list, font_name_list) == 0)
+        return match->font;
+
+    /* Try font names of the comma or space separated list in order */
     font_name = font_name_list;
-    while (font_found == 0 &&
-           font_name[end_pos] != '\0')
-    {
-        tmp_data = '\0';
-        /* Scan for seperator */
-        while (font_name[end_pos] != '\0') {
-            if (font_name[end_pos] == ',' || font_name[end_pos] == ' ' ||
-              font_name[end_pos] == '\t')
-            {
-                tmp_data = font_name[end_pos];
-                font_name[end_pos] = '\0';
-                break;
-            }
-            end_pos++;
-        }       
-
-        /* Search for exact font-name match */
-        for (i=0; i<__COUNTOF(s_device_fonts); i++) {
-           if (s_device_fonts[i].valid == 0)
-               continue;
-
-           /* For vector font only compare name */
-           if (s_device_fonts[i].font_params.font_type == eFontTypeVector ) {
-                if ( strlen(font_name) > 0 &&
-                    strcmp(font_name, 
-                    s_device_fonts[i].font_params.name) == 0)
-                {
-                   font_name[end_pos] = tmp_data; /* Restor delimeter */
-                   return i;
-                }
-           } else {
-                /* For raster font compare all properties */
-                if (s_device_fonts[i].font_params.font_weight == font_weight &&
-                    s_device_fonts[i].font_params.font_stretch == font_stretch &&
-                    s_device_fonts[i].font_params.font_style == font_style ) 
-                {
-                    if ( strlen(font_name) > 0 &&
-                        strcmp(font_name, 
-                        s_device_fonts[i].font_params.name) == 0)
-                    {
-                       font_name[end_pos] = tmp_data; /* Restor delimeter */
-
-                       if (s_device_fonts[i].font_params.font_height == font_height)
-                       {
-                            return i;
-                       }
-                        /* Update font_name_list to improve future searches */
-                        strncpy(font_name_list, font_name, strlen(font_name)+1);
-                    }
-                }
-            }
+    while (*font_name != '\0' && font == VG_LITE_INVALID_FONT) {
+        len = strcspn(font_name, ", \t");
+        if (len > 0) {
+            font = lookup_font(font_name, len, font_weight, font_stretch,
+                               font_style, font_height);
         }
-        /* Continue searching for other font entries */
-        font_name[end_pos] = tmp_data;
-        font_name += (end_pos + 1);
-        end_pos = 0;
+        font_name += len;
+        if (*font_name != '\0')
+            font_name++;
     }
-    printf("WARNING: [%s] Font not found\r\n",font_name_list);
 
-    return VG_LITE_INVALID_FONT;
+    if (font == VG_LITE_INVALID_FONT)
+        printf("WARNING: [%s] Font not found\r\n",font_name_list);
+
+    /* Remember the result, misses included */
+    if (list_len < MAX_FONT_NAME_LEN) {
+        strcpy(match->font_name_list, font_name_list);
+        match->hash = hash;
+        match->weight = font_weight;
+        match->stretch = font_stretch;
+        match->style = font_style;
+        match->font_height = font_height;
+        match->font = font;
+        match->valid = 1;
+    }
+
+    return font;
 }
 
 void vg_lite_text_init(void)
@@ -389,6 +612,7 @@ void vg_lite_text_init(void)
 
     /* Initialize font table */
     memset(s_device_fonts, 0, MAX_SYSTEM_FONTS * sizeof(font_info_internal_t));
+    rebuild_font_index();
     font_table_ready = 1;
 }
 
@@ -644,21 +868,140 @@ int read_rle_font_from_buffer(char *buff, int size, struct mf_font_s* font)
 	return 0;
 }
 
+/* Locate a length prefixed blob in the font data without reading it */
+static char *map_blob(char *buff, int size, int *offset, int unit,
+                      uint32_t *blob_size)
+{
+    uint16_t blob_len;
+
+    if (*offset < 0 || *offset + 2 > size)
+        return NULL;
+    /* Length prefix is stored in the same byte order bufferred_fread uses */
+    memcpy(&blob_len, buff + *offset, sizeof(blob_len));
+    if (*offset + 2 + blob_len * unit > size)
+        return NULL;
+
+    *blob_size = blob_len * unit;
+    *offset += 2 + blob_len * unit;
+    return buff + *offset - blob_len * unit;
+}
+
+/* 16-bit tables are used in place when aligned, otherwise copied */
+static int map_16b_blob(char *buff, int size, int *offset,
+                        uint16_t **ary, uint32_t *ary_len)
+{
+    char *p = map_blob(buff, size, offset, 2, ary_len);
+
+    if (p == NULL) {
+        TRACE_ERR(("ERROR: 16b blob outside font data\n"));
+        return VG_LITE_INVALID_ARGUMENT;
+    }
+    if ((((unsigned long)p) & 0x1) == 0) {
+        *ary = (uint16_t *)p;
+        return 0;
+    }
+
+    TRACE_DBG(("16b blob at %08x not aligned, copying\r\n", *offset));
+    *ary = (uint16_t *)RCD_ALLOC(*ary_len ? *ary_len : 2);
+    if (*ary == NULL) {
+        TRACE_ERR(("ERROR: malloc failed\n"));
+        return VG_LITE_OUT_OF_MEMORY;
+    }
+    memcpy(*ary, p, *ary_len);
+    return 0;
+}
+
+/* Same as read_rle_font_from_buffer, but tables point into the buffer */
+int map_rle_font_from_buffer(char *buff, int size, struct mf_font_s* font)
+{
+    struct mf_rlefont_s* mfont = (struct mf_rlefont_s*)font;
+    struct mf_rlefont_char_range_s *range;
+    bufferred_reader_t f_obj;
+    int offset;
+    int ret;
+    uint32_t i;
+
+    if ( bufferred_fopen(&f_obj, buff, size) < 0 ) {
+        /* Font file open failed */
+        return VG_LITE_INVALID_ARGUMENT;
+    }
+    /* Only the small header and range descriptors get allocated */
+    offset = read_rle_font_header(&f_obj, font);
+    bufferred_fclose(&f_obj);
+    if (offset < 0)
+        return VG_LITE_INVALID_ARGUMENT;
+    if (mfont->dictionary_data_fp_offset != (uint32_t)offset) {
+        TRACE_ERR(("ERROR: dictonary offset is different"));
+    }
+
+    mfont->dictionary_data = (uint8_t *)map_blob(buff, size, &offset, 1,
+                                                 &mfont->dictionary_data_size);
+    if (mfont->dictionary_data == NULL)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    ret = map_16b_blob(buff, size, &offset,
+        &mfont->dictionary_offsets, &mfont->dictionary_offsets_size);
+    if (ret != 0)
+        return ret;
+
+    /* Dictionary entries must stay inside the dictionary */
+    for (i = 0; i < mfont->dictionary_offsets_size / 2; i++) {
+        if (mfont->dictionary_offsets[i] > mfont->dictionary_data_size ||
+            (i > 0 && mfont->dictionary_offsets[i] < mfont->dictionary_offsets[i - 1]))
+            return VG_LITE_INVALID_ARGUMENT;
+    }
+
+    for (int r = 0; r < mfont->char_range_count; r++) {
+        range = &mfont->char_ranges[r];
+
+        ret = map_16b_blob(buff, size, &offset,
+            &range->glyph_offsets, &range->glyph_offsets_size);
+        if (ret != 0)
+            return ret;
+
+        range->glyph_data = (uint8_t *)map_blob(buff, size, &offset, 1,
+                                                &range->glyph_data_size);
+        if (range->glyph_data == NULL)
+            return VG_LITE_INVALID_ARGUMENT;
+
+        /* Every character of the range needs a glyph inside the range data */
+        if (range->glyph_offsets_size / 2 < range->char_count)
+            return VG_LITE_INVALID_ARGUMENT;
+        for (i = 0; i < range->char_count; i++) {
+            if (range->glyph_offsets[i] >= range->glyph_data_size)
+                return VG_LITE_INVALID_ARGUMENT;
+        }
+    }
+
+    return 0;
+}
+
 int load_raster_font(char *data, int data_len, struct mf_font_s** font)
 {
     int ret;
 
+    rle_font_desc_t *desc;
+
     /* Allocate font memory */
-    *font = (struct mf_font_s*)RCD_ALLOC(sizeof(struct mf_rlefont_s));
+    desc = (rle_font_desc_t *)RCD_ALLOC(sizeof(rle_font_desc_t));
+    *font = (struct mf_font_s*)desc;
     if (*font == NULL) {
         return VG_LITE_OUT_OF_MEMORY;
     }
-    memset(*font, 0, sizeof(struct mf_rlefont_s));
+    memset(desc, 0, sizeof(rle_font_desc_t));
 
     /* Load font from file */
+#if RCD_LOAD_IN_PLACE
+    desc->data = data;
+    desc->data_len = data_len;
+    ret = map_rle_font_from_buffer(data,
+                                   data_len, *font);
+#else
     ret = read_rle_font_from_buffer(data,
                                     data_len, *font);
-    if (ret < 0) {
+#endif
+    if (ret != 0) {
+        free_rle_font_memory(font);
         return ret;
     }
 
@@ -678,22 +1021,34 @@ int load_raster_font(char *data, int data_len, struct mf_font_s** font)
     return 0;
 }
 
+/* Free a font table unless it is mapped from the font data */
+static void free_rle_font_table(rle_font_desc_t *desc, void *table)
+{
+    if (table == NULL)
+        return;
+    if ((const char *)table >= desc->data &&
+        (const char *)table < desc->data + desc->data_len)
+        return;
+    RCD_FREE(table);
+}
+
 int free_rle_font_memory(struct mf_font_s** font)
 {
     struct mf_rlefont_s* mfont = (struct mf_rlefont_s*)(*font);
-
-    RCD_FREE(mfont->font.full_name);
-    RCD_FREE(mfont->font.short_name);
-    RCD_FREE(mfont->dictionary_data);
-    RCD_FREE(mfont->dictionary_offsets);
-    for (int r = 0; r < mfont->char_range_count; r++) {
-        RCD_FREE(mfont->char_ranges[r].glyph_offsets);
-        RCD_FREE(mfont->char_ranges[r].glyph_data);
+    rle_font_desc_t *desc = (rle_font_desc_t *)(*font);
+
+    free_rle_font_table(desc, mfont->font.full_name);
+    free_rle_font_table(desc, mfont->font.short_name);
+    free_rle_font_table(desc, mfont->dictionary_data);
+    free_rle_font_table(desc, mfont->dictionary_offsets);
+    for (int r = 0; mfont->char_ranges != NULL && r < mfont->char_range_count; r++) {
+        free_rle_font_table(desc, mfont->char_ranges[r].glyph_offsets);
+        free_rle_font_table(desc, mfont->char_ranges[r].glyph_data);
     }
     #ifdef DEBUG_RESET_DATASTRUCTURE_ON_FREE
     memset(mfont->char_ranges);
     #endif
-    RCD_FREE(mfont->char_ranges);
+    free_rle_font_table(desc, mfont->char_ranges);
 
     #ifdef DEBUG_RESET_DATASTRUCTURE_ON_FREE
     memset(mfont);
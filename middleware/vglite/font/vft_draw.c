@@ -119,10 +119,16 @@ void glyph_cache_init(void)
     }
 }
 
-void glyph_cache_free(void)
+/* Release cached glyph paths of a font face, or of all faces for NULL */
+void glyph_cache_free(font_face_desc_t *font_face)
 {
     int i;
     for (i=0; i<GLYPH_CACHE_SIZE; i++) {
+        if ( font_face != NULL && g_glyph_cache[i].g != NULL &&
+             (g_glyph_cache[i].g < font_face->glyphs ||
+              g_glyph_cache[i].g >= font_face->glyphs + font_face->num_glyphs) ) {
+            continue;
+        }
         if ( g_glyph_cache[i].h_path != NULL ) {
             /* For non-mapped path this resetting is sufficient */
             vg_lite_clear_path(g_glyph_cache[i].h_path);
@@ -133,10 +139,14 @@ void glyph_cache_free(void)
             /* Reset pointer */
             g_glyph_cache[i].h_path = NULL;
         }
+        g_glyph_cache[i].g = NULL;
+        g_glyph_cache[i].use_count = 0;
     }
 
     /* Next time font init will be required */
-    g_glyph_cache_init_done = 0;
+    if ( font_face == NULL ) {
+        g_glyph_cache_init_done = 0;
+    }
 }
 
 vg_lite_path_t *vft_cache_lookup(glyph_desc_t *g)
@@ -144,13 +154,12 @@ vg_lite_path_t *vft_cache_lookup(glyph_desc_t *g)
     int i;
     int unused_idx = 0;
 
-    /* Not present caching code does not handle multiple font-face */
     glyph_cache_init();
 
-    /* Check if path object for given glyph exists */
+    /* Check if path object for given glyph exists, glyph descriptors
+     * are unique across font faces */
     for (i=0; i<GLYPH_CACHE_SIZE; i++) {
-        if ( g_glyph_cache[i].g != NULL && g->unicode == 
-            g_glyph_cache[i].g->unicode )
+        if ( g_glyph_cache[i].g == g )
         {
             g_glyph_cache[i].use_count++;
             return g_glyph_cache[i].h_path;
@@ -466,6 +475,6 @@ path_desc_t* vft_get_glyph_path(glyph_desc_t* g2)
 /* Unload font face descriptor and all glyphs */
 void vft_unload(font_face_desc_t* font_face)
 {
-    glyph_cache_free();
+    glyph_cache_free(font_face);
     //VFT_FREE(font_face);
 }
@@ -37,6 +37,20 @@
 #include "vft_draw.h"
 
 /** Macros */
+/* Number of text layouts kept for reuse */
+#ifndef VG_LITE_TEXT_LAYOUT_CACHE_SIZE
+#define VG_LITE_TEXT_LAYOUT_CACHE_SIZE 16
+#endif
+
+/* Number of fonts that can have a glyph atlas at the same time */
+#ifndef VG_LITE_GLYPH_ATLAS_COUNT
+#define VG_LITE_GLYPH_ATLAS_COUNT 4
+#endif
+
+/* Number of glyph rows the atlas packer can open */
+#ifndef VG_LITE_GLYPH_ATLAS_MAX_SHELVES
+#define VG_LITE_GLYPH_ATLAS_MAX_SHELVES 32
+#endif
 
 /** Data structures */
 typedef struct {
@@ -49,6 +63,51 @@ typedef struct {
     const struct mf_font_s *rcd_font;
 } text_context_t;
 
+typedef struct {
+    /* Layout being built */
+    vg_lite_text_layout_t *layout;
+    const struct mf_font_s *rcd_font;
+    uint16_t glyph_capacity;
+    uint16_t line_capacity;
+    /* Source position of the next character on the current line */
+    mf_str cursor;
+    uint16_t chars;
+    int16_t y;
+} layout_context_t;
+
+/* Location of a pre-rendered glyph inside the atlas */
+typedef struct {
+    uint16_t character;
+    uint16_t x;
+    uint16_t y;
+    uint8_t  width;     /* Ink box, 0 for blank glyphs */
+    uint8_t  height;
+    uint8_t  dx;        /* Ink box offset inside the glyph cell */
+    uint8_t  dy;
+} atlas_glyph_t;
+
+/* Row of glyphs packed side by side */
+typedef struct {
+    uint16_t y;
+    uint16_t x;
+    uint16_t height;
+} atlas_shelf_t;
+
+typedef struct {
+    vg_lite_font_t font;
+    const struct mf_font_s *rcd_font;
+    vg_lite_buffer_t buffer;
+    /* Packed glyphs, sorted by character */
+    atlas_glyph_t *glyphs;
+    uint16_t glyph_count;
+    uint16_t glyph_capacity;
+    atlas_shelf_t shelves[VG_LITE_GLYPH_ATLAS_MAX_SHELVES];
+    uint16_t shelf_count;
+    uint32_t used_pixels;
+    /* One glyph cell, glyphs are decoded here before packing */
+    uint8_t *scratch;
+} glyph_atlas_t;
+
 /** Internal or external API prototypes */
 struct mf_font_s *_vg_lite_get_raster_font(vg_lite_font_t font_idx);
 int vg_lite_is_font_valid(vg_lite_font_t font);
@@ -63,6 +122,13 @@ int g_last_font_attrib_idx;
 /* Capture unique values of alpha */
 static unsigned int g_index_table[257];
 
+/* Recently used text layouts */
+static vg_lite_text_layout_t g_text_layouts[VG_LITE_TEXT_LAYOUT_CACHE_SIZE];
+static uint32_t g_text_layout_stamp;
+
+/* Pre-rendered glyph sets */
+static glyph_atlas_t g_glyph_atlases[VG_LITE_GLYPH_ATLAS_COUNT];
+
 /* text_color is in ARGB8888 format */
 int init_256pallet_color_table(unsigned int bg_color, unsigned int fg_color)
 {
@@ -125,27 +191,6 @@ static uint8_t character_callback(int16_t x, int16_t y, mf_char character,
     return mf_render_character(s->rcd_font, x, y, character, pixel_callback, state);
 }
 
-/* Callback to render lines. */
-static bool line_callback(const char *line, uint16_t count, void *state)
-{
-    text_context_t *s = (text_context_t*)state;
-
-    if (s->attributes->justify)
-    {
-        mf_render_justified(s->rcd_font, s->attributes->anchor, s->y,
-                            s->width - s->attributes->margin * 2,
-                            line, count, character_callback, state);
-    }
-    else
-    {
-        mf_render_aligned(s->rcd_font, s->attributes->anchor, s->y,
-                          (enum mf_align_t)s->attributes->alignment, line, count,
-                          character_callback, state);
-    }
-    s->y += s->rcd_font->line_height;
-    return true;
-}
-
 /* Callback to just count the lines.
  * Used to decide the image height */
 bool count_lines(const char *line, uint16_t count, void *state)
@@ -204,36 +249,727 @@ void matrix_multiply(vg_lite_matrix_t * matrix, vg_lite_matrix_t * mult)
     memcpy(matrix, &temp, sizeof(temp));
 }
 
-vg_lite_error_t vg_lite_draw_text(vg_lite_buffer_t *target,
-                                  char *text,
-                                  vg_lite_font_t font,
-                                  int x,
-                                  int y,
-                                  vg_lite_matrix_t *matrix,
-                                  vg_lite_blend_t blend,
-                                  vg_lite_font_attributes_t *attributes)
+/** Text layout */
+
+/* Hash the text and return its length in bytes */
+static uint32_t text_hash(const char *text, int *length)
+{
+    const unsigned char *p = (const unsigned char *)text;
+    uint32_t hash = 2166136261u; /* FNV-1a */
+
+    while (*p) {
+        hash ^= *p++;
+        hash *= 16777619u;
+    }
+    *length = (int)((const char *)p - text);
+
+    return hash;
+}
+
+static void release_text_layout(vg_lite_text_layout_t *layout)
+{
+    /* Glyphs, lines and text share a single allocation */
+    if (layout->glyphs != NULL)
+        _mem_free(layout->glyphs);
+    memset(layout, 0, sizeof(*layout));
+    layout->font = VG_LITE_INVALID_FONT;
+}
+
+/* Callback to record glyph positions of a line. */
+static uint8_t layout_glyph_callback(int16_t x, int16_t y, mf_char character,
+                                     void *state)
+{
+    layout_context_t *s = (layout_context_t*)state;
+    vg_lite_text_layout_t *layout = s->layout;
+    vg_lite_text_glyph_t *glyph;
+    uint8_t advance;
+    mf_str pos;
+    mf_char c;
+
+    advance = mf_character_width(s->rcd_font, character);
+
+    /* Find the character in the source text. mcufont consumes tabs
+     * without calling back, so skip anything that does not match. */
+    do {
+        pos = s->cursor;
+        c = mf_getchar(&s->cursor);
+        if (c == 0) {
+            mf_rewind(&s->cursor);
+            return advance;
+        }
+        s->chars++;
+#if !MF_USE_TABS
+        if (c == '\t')
+            c = ' ';
+#endif
+    } while (c != character);
+
+    if (layout->glyph_count < s->glyph_capacity) {
+        glyph = &layout->glyphs[layout->glyph_count++];
+        glyph->x = x;
+        glyph->y = y;
+        glyph->character = character;
+        glyph->offset = (uint16_t)(pos - layout->text);
+        glyph->advance = advance;
+    }
+
+    return advance;
+}
+
+/* Callback to record one wrapped line. */
+static bool layout_line_callback(const char *line, uint16_t count, void *state)
+{
+    layout_context_t *s = (layout_context_t*)state;
+    vg_lite_text_layout_t *layout = s->layout;
+    vg_lite_text_line_t *l;
+    vg_lite_text_glyph_t *last;
+    int16_t advance;
+    mf_char c;
+
+    if (layout->line_count >= s->line_capacity)
+        return false;
+
+    l = &layout->lines[layout->line_count++];
+    l->first_glyph = layout->glyph_count;
+    l->offset = (uint16_t)(line - layout->text);
+    l->chars = count;
+    l->x = 0;
+    l->width = 0;
+
+    /* Lines are laid out left aligned at x = 0, alignment and
+     * justification are applied once the block width is known. */
+    s->cursor = line;
+    s->chars = 0;
+    mf_render_aligned(s->rcd_font, 0, s->y, MF_ALIGN_LEFT, line, count,
+                      layout_glyph_callback, state);
+    l->glyph_count = layout->glyph_count - l->first_glyph;
+
+    if (l->glyph_count != 0) {
+        last = &layout->glyphs[layout->glyph_count - 1];
+        l->width = last->x + last->advance + s->rcd_font->baseline_x;
+    }
+
+    /* Trailing white space still moves the pen for the following text */
+    advance = l->width;
+    while (s->chars < count && *s->cursor) {
+        c = mf_getchar(&s->cursor);
+        s->chars++;
+        if (c == '\n' || c == '\r')
+            continue;
+        advance += mf_character_width(s->rcd_font, (c == '\t') ? ' ' : c);
+    }
+    if (layout->advance < advance)
+        layout->advance = advance;
+    if (layout->width < l->width)
+        layout->width = l->width;
+
+    s->y += s->rcd_font->line_height;
+    return true;
+}
+
+/* Spread the free space of a line over its spaces, as mf_render_justified */
+static void justify_line(vg_lite_text_layout_t *layout,
+                         vg_lite_text_line_t *line)
+{
+    vg_lite_text_glyph_t *glyph = &layout->glyphs[line->first_glyph];
+    int16_t adjustment = layout->width - line->width;
+    int16_t shift = 0;
+    int16_t tmp;
+    uint16_t spaces = 0;
+    uint16_t i;
+
+    for (i = 0; i < line->glyph_count; i++) {
+        if (glyph[i].character == ' ' || glyph[i].character == 0xA0)
+            spaces++;
+    }
+    if (spaces == 0 || adjustment <= 0)
+        return;
+
+    for (i = 0; i < line->glyph_count; i++) {
+        if (glyph[i].character == ' ' || glyph[i].character == 0xA0) {
+            tmp = (adjustment + spaces / 2) / spaces;
+            adjustment -= tmp;
+            spaces--;
+            shift += tmp;
+        }
+        glyph[i].x += shift;
+    }
+    line->width = layout->width;
+}
+
+static vg_lite_error_t build_text_layout(vg_lite_text_layout_t *layout,
+                                         const struct mf_font_s *rcd_font,
+                                         const char *text,
+                                         int length)
+{
+    layout_context_t ctx;
+    vg_lite_text_line_t *line;
+    vg_lite_text_glyph_t *glyph;
+    int16_t shift;
+    char *memory;
+    int i, j;
+
+    /* Every glyph and every line consumes at least one character */
+    memory = (char *)_mem_allocate(length * sizeof(vg_lite_text_glyph_t) +
+                                   (length + 1) * sizeof(vg_lite_text_line_t) +
+                                   length + 1);
+    if (memory == NULL)
+        return VG_LITE_OUT_OF_MEMORY;
+
+    layout->glyphs = (vg_lite_text_glyph_t *)memory;
+    memory += length * sizeof(vg_lite_text_glyph_t);
+    layout->lines = (vg_lite_text_line_t *)memory;
+    memory += (length + 1) * sizeof(vg_lite_text_line_t);
+    layout->text = memory;
+    memcpy(layout->text, text, length + 1);
+
+    layout->line_height = rcd_font->line_height;
+    layout->line_count = 0;
+    layout->glyph_count = 0;
+    layout->width = 0;
+    layout->advance = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.layout = layout;
+    ctx.rcd_font = rcd_font;
+    ctx.glyph_capacity = (uint16_t)length;
+    ctx.line_capacity = (uint16_t)(length + 1);
+    mf_wordwrap(rcd_font, layout->wrap_width, layout->text,
+                layout_line_callback, &ctx);
+
+    layout->height = layout->line_count * layout->line_height;
+
+    for (i = 0; i < layout->line_count; i++) {
+        line = &layout->lines[i];
+
+        if (layout->justify) {
+            /* Last line of a paragraph is not justified */
+            if (i + 1 < layout->line_count &&
+                layout->text[layout->lines[i + 1].offset - 1] != '\n')
+                justify_line(layout, line);
+            continue;
+        }
+
+        if (layout->alignment == eTextAlignCenter)
+            shift = (layout->width - line->width) / 2;
+        else if (layout->alignment == eTextAlignRight)
+            shift = layout->width - line->width;
+        else
+            shift = 0;
+
+        if (shift != 0) {
+            line->x = shift;
+            glyph = &layout->glyphs[line->first_glyph];
+            for (j = 0; j < line->glyph_count; j++)
+                glyph[j].x += shift;
+        }
+    }
+
+    return VG_LITE_SUCCESS;
+}
+
+vg_lite_error_t vg_lite_get_text_layout(char *text,
+                                        vg_lite_font_t font,
+                                        vg_lite_font_attributes_t *attributes,
+                                        const vg_lite_text_layout_t **layout)
+{
+    const struct mf_font_s *rcd_font;
+    vg_lite_text_layout_t *entry;
+    vg_lite_text_layout_t *victim = NULL;
+    vg_lite_error_t error;
+    int16_t wrap_width;
+    uint8_t alignment, justify;
+    uint32_t hash;
+    int length;
+    int i;
+
+    if (text == NULL || attributes == NULL || layout == NULL)
+        return VG_LITE_INVALID_ARGUMENT;
+    *layout = NULL;
+
+    if (vg_lite_is_font_valid(font) != 0 || vg_lite_is_vector_font(font))
+        return VG_LITE_INVALID_ARGUMENT;
+
+    if (vg_lite_load_font_data(font, attributes->font_height) != 0)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    rcd_font = _vg_lite_get_raster_font(font);
+    if (rcd_font == NULL)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    hash = text_hash(text, &length);
+    if (length > 0xFFFF)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    wrap_width = (int16_t)(attributes->width - 2 * attributes->margin);
+    justify = (attributes->justify != 0 ||
+               attributes->alignment == eTextAlignJustify) ? 1 : 0;
+    alignment = justify ? eTextAlignLeft : (uint8_t)attributes->alignment;
+
+    g_text_layout_stamp++;
+    for (i = 0; i < VG_LITE_TEXT_LAYOUT_CACHE_SIZE; i++) {
+        entry = &g_text_layouts[i];
+        if (entry->text == NULL) {
+            if (victim == NULL || victim->text != NULL)
+                victim = entry;
+            continue;
+        }
+        if (entry->hash == hash && entry->font == font &&
+            entry->font_data == rcd_font &&
+            entry->wrap_width == wrap_width &&
+            entry->alignment == alignment && entry->justify == justify &&
+            strcmp(entry->text, text) == 0) {
+            entry->last_used = g_text_layout_stamp;
+            *layout = entry;
+            return VG_LITE_SUCCESS;
+        }
+        if (victim == NULL ||
+            (victim->text != NULL && entry->last_used < victim->last_used))
+            victim = entry;
+    }
+
+    /* Not cached, lay the text out into the least recently used entry */
+    release_text_layout(victim);
+    victim->font = font;
+    victim->font_data = rcd_font;
+    victim->hash = hash;
+    victim->wrap_width = wrap_width;
+    victim->alignment = alignment;
+    victim->justify = justify;
+
+    error = build_text_layout(victim, rcd_font, text, length);
+    if (error != VG_LITE_SUCCESS) {
+        release_text_layout(victim);
+        return error;
+    }
+    victim->last_used = g_text_layout_stamp;
+    *layout = victim;
+
+    return VG_LITE_SUCCESS;
+}
+
+int vg_lite_text_hit_test(const vg_lite_text_layout_t *layout, int x, int y)
+{
+    const vg_lite_text_line_t *line;
+    const vg_lite_text_glyph_t *glyph;
+    int i;
+
+    if (layout == NULL || layout->line_height == 0 || y < 0 || x < 0)
+        return -1;
+
+    i = y / layout->line_height;
+    if (i >= layout->line_count)
+        return -1;
+
+    line = &layout->lines[i];
+    glyph = &layout->glyphs[line->first_glyph];
+    for (i = 0; i < line->glyph_count; i++) {
+        if (x >= glyph[i].x && x < glyph[i].x + glyph[i].advance)
+            return glyph[i].offset;
+    }
+
+    return -1;
+}
+
+void vg_lite_flush_text_layouts(vg_lite_font_t font)
+{
+    int i;
+
+    for (i = 0; i < VG_LITE_TEXT_LAYOUT_CACHE_SIZE; i++) {
+        if (g_text_layouts[i].text == NULL)
+            continue;
+        if (font == VG_LITE_INVALID_FONT || g_text_layouts[i].font == font)
+            release_text_layout(&g_text_layouts[i]);
+    }
+}
+
+/** Glyph atlas */
+
+static glyph_atlas_t *find_glyph_atlas(vg_lite_font_t font)
+{
+    int i;
+
+    for (i = 0; i < VG_LITE_GLYPH_ATLAS_COUNT; i++) {
+        if (g_glyph_atlases[i].glyphs != NULL &&
+            g_glyph_atlases[i].font == font)
+            return &g_glyph_atlases[i];
+    }
+
+    return NULL;
+}
+
+/* Binary search, returns the insert position when the glyph is missing */
+static int atlas_glyph_index(const glyph_atlas_t *atlas, mf_char character,
+                             int *found)
+{
+    int low = 0, high = atlas->glyph_count;
+    int mid;
+
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (atlas->glyphs[mid].character < character)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    *found = (low < atlas->glyph_count &&
+              atlas->glyphs[low].character == character);
+
+    return low;
+}
+
+/* Callback to decode a glyph into the scratch cell. */
+static void atlas_pixel_callback(int16_t x, int16_t y, uint8_t count,
+                                 uint8_t alpha, void *state)
+{
+    glyph_atlas_t *atlas = (glyph_atlas_t*)state;
+    const struct mf_font_s *font = atlas->rcd_font;
+
+    if (y < 0 || y >= font->height || x < 0 || x >= font->width)
+        return;
+    if (x + count > font->width)
+        count = font->width - x;
+
+    memset(atlas->scratch + y * font->width + x, alpha, count);
+}
+
+/* Find room for a w x h box, shelves are filled best fit by height. */
+static vg_lite_error_t atlas_pack(glyph_atlas_t *atlas, int w, int h,
+                                  uint16_t *x, uint16_t *y)
+{
+    atlas_shelf_t *shelf = NULL;
+    atlas_shelf_t *last;
+    int top;
+    int i;
+
+    for (i = 0; i < atlas->shelf_count; i++) {
+        if (atlas->shelves[i].height >= h &&
+            atlas->shelves[i].x + w <= atlas->buffer.width &&
+            (shelf == NULL || atlas->shelves[i].height < shelf->height))
+            shelf = &atlas->shelves[i];
+    }
+
+    if (shelf == NULL) {
+        /* Open a new shelf below the last one */
+        top = 0;
+        if (atlas->shelf_count != 0) {
+            last = &atlas->shelves[atlas->shelf_count - 1];
+            top = last->y + last->height;
+        }
+        if (atlas->shelf_count >= VG_LITE_GLYPH_ATLAS_MAX_SHELVES ||
+            top + h > atlas->buffer.height || w > atlas->buffer.width)
+            return VG_LITE_OUT_OF_RESOURCES;
+
+        shelf = &atlas->shelves[atlas->shelf_count++];
+        shelf->y = top;
+        shelf->x = 0;
+        shelf->height = h;
+    }
+
+    *x = shelf->x;
+    *y = shelf->y;
+    shelf->x += w;
+
+    return VG_LITE_SUCCESS;
+}
+
+/* Rasterize a glyph into the atlas unless it is already there. */
+static vg_lite_error_t atlas_insert(glyph_atlas_t *atlas, mf_char character,
+                                    const atlas_glyph_t **result)
+{
+    const struct mf_font_s *font = atlas->rcd_font;
+    atlas_glyph_t glyph;
+    atlas_glyph_t *glyphs;
+    uint8_t *src, *dst;
+    int min_x, min_y, max_x, max_y;
+    int index, found;
+    int i, j;
+
+    index = atlas_glyph_index(atlas, character, &found);
+    if (found) {
+        if (result != NULL)
+            *result = &atlas->glyphs[index];
+        return VG_LITE_SUCCESS;
+    }
+
+    /* Grow the glyph table before touching the atlas */
+    if (atlas->glyph_count == atlas->glyph_capacity) {
+        if (atlas->glyph_capacity >= 0x8000)
+            return VG_LITE_OUT_OF_RESOURCES;
+        glyphs = (atlas_glyph_t *)_mem_allocate(2 * atlas->glyph_capacity *
+                                                sizeof(atlas_glyph_t));
+        if (glyphs == NULL)
+            return VG_LITE_OUT_OF_MEMORY;
+        memcpy(glyphs, atlas->glyphs,
+               atlas->glyph_count * sizeof(atlas_glyph_t));
+        _mem_free(atlas->glyphs);
+        atlas->glyphs = glyphs;
+        atlas->glyph_capacity *= 2;
+    }
+
+    /* Decode the glyph cell and find the ink box */
+    memset(atlas->scratch, 0, font->width * font->height);
+    mf_render_character(font, 0, 0, character, atlas_pixel_callback, atlas);
+
+    min_x = font->width;
+    min_y = font->height;
+    max_x = max_y = -1;
+    for (j = 0; j < font->height; j++) {
+        src = atlas->scratch + j * font->width;
+        for (i = 0; i < font->width; i++) {
+            if (src[i] == 0)
+                continue;
+            if (i < min_x) min_x = i;
+            if (i > max_x) max_x = i;
+            if (j < min_y) min_y = j;
+            if (j > max_y) max_y = j;
+        }
+    }
+
+    memset(&glyph, 0, sizeof(glyph));
+    glyph.character = character;
+    if (max_x >= 0) {
+        glyph.width = max_x - min_x + 1;
+        glyph.height = max_y - min_y + 1;
+        glyph.dx = min_x;
+        glyph.dy = min_y;
+        if (atlas_pack(atlas, glyph.width, glyph.height,
+                       &glyph.x, &glyph.y) != VG_LITE_SUCCESS)
+            return VG_LITE_OUT_OF_RESOURCES;
+
+        for (j = 0; j < glyph.height; j++) {
+            src = atlas->scratch + (min_y + j) * font->width + min_x;
+            dst = (uint8_t *)atlas->buffer.memory +
+                  (glyph.y + j) * atlas->buffer.stride + glyph.x;
+            memcpy(dst, src, glyph.width);
+        }
+        atlas->used_pixels += glyph.width * glyph.height;
+    }
+
+    memmove(&atlas->glyphs[index + 1], &atlas->glyphs[index],
+            (atlas->glyph_count - index) * sizeof(atlas_glyph_t));
+    atlas->glyphs[index] = glyph;
+    atlas->glyph_count++;
+    if (result != NULL)
+        *result = &atlas->glyphs[index];
+
+    return VG_LITE_SUCCESS;
+}
+
+vg_lite_error_t vg_lite_glyph_atlas_insert(vg_lite_font_t font,
+                                           char *characters)
+{
+    glyph_atlas_t *atlas;
+    vg_lite_error_t error;
+    mf_str text = characters;
+    mf_char c;
+
+    atlas = find_glyph_atlas(font);
+    if (atlas == NULL || characters == NULL)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    while ((c = mf_getchar(&text)) != 0) {
+        error = atlas_insert(atlas, c, NULL);
+        if (error != VG_LITE_SUCCESS)
+            return error;
+    }
+
+    return VG_LITE_SUCCESS;
+}
+
+vg_lite_error_t vg_lite_create_glyph_atlas(vg_lite_font_t font,
+                                           int width,
+                                           int height,
+                                           char *characters)
+{
+    const struct mf_font_s *rcd_font;
+    const struct mf_rlefont_s *rle_font;
+    glyph_atlas_t *atlas = NULL;
+    vg_lite_error_t error;
+    int i, c;
+
+    if (vg_lite_is_font_valid(font) != 0 || vg_lite_is_vector_font(font))
+        return VG_LITE_INVALID_ARGUMENT;
+    if (width <= 0 || height <= 0 || width > 0xFFF0 || height > 0xFFFF)
+        return VG_LITE_INVALID_ARGUMENT;
+    if (find_glyph_atlas(font) != NULL)
+        return VG_LITE_ALREADY_EXISTS;
+
+    rcd_font = _vg_lite_get_raster_font(font);
+    if (rcd_font == NULL || rcd_font->width == 0 || rcd_font->height == 0)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    for (i = 0; i < VG_LITE_GLYPH_ATLAS_COUNT; i++) {
+        if (g_glyph_atlases[i].glyphs == NULL) {
+            atlas = &g_glyph_atlases[i];
+            break;
+        }
+    }
+    if (atlas == NULL)
+        return VG_LITE_OUT_OF_RESOURCES;
+
+    memset(atlas, 0, sizeof(*atlas));
+
+    /* Glyph coverage is tinted with the text color at draw time */
+    atlas->buffer.width = (width + 15) & (~15);
+    atlas->buffer.height = height;
+    atlas->buffer.format = VG_LITE_A8;
+    error = vg_lite_allocate(&atlas->buffer);
+    if (error != VG_LITE_SUCCESS)
+        return error;
+    atlas->buffer.image_mode = VG_LITE_MULTIPLY_IMAGE_MODE;
+    memset(atlas->buffer.memory, 0, atlas->buffer.stride * atlas->buffer.height);
+
+    atlas->scratch = (uint8_t *)_mem_allocate(rcd_font->width * rcd_font->height);
+    atlas->glyphs = (atlas_glyph_t *)_mem_allocate(32 * sizeof(atlas_glyph_t));
+    if (atlas->scratch == NULL || atlas->glyphs == NULL) {
+        if (atlas->scratch != NULL)
+            _mem_free(atlas->scratch);
+        if (atlas->glyphs != NULL)
+            _mem_free(atlas->glyphs);
+        vg_lite_free(&atlas->buffer);
+        memset(atlas, 0, sizeof(*atlas));
+        return VG_LITE_OUT_OF_MEMORY;
+    }
+    atlas->glyph_capacity = 32;
+    atlas->font = font;
+    atlas->rcd_font = rcd_font;
+
+    if (characters != NULL) {
+        error = vg_lite_glyph_atlas_insert(font, characters);
+    } else {
+        /* Whole glyph set of the font */
+        rle_font = (const struct mf_rlefont_s *)rcd_font;
+        for (i = 0; i < rle_font->char_range_count && error == VG_LITE_SUCCESS; i++) {
+            for (c = 0; c < rle_font->char_ranges[i].char_count; c++) {
+                error = atlas_insert(atlas,
+                                     rle_font->char_ranges[i].first_char + c, NULL);
+                if (error != VG_LITE_SUCCESS)
+                    break;
+            }
+        }
+    }
+
+    /* Do not leave a partial atlas registered for the font */
+    if (error != VG_LITE_SUCCESS)
+        vg_lite_destroy_glyph_atlas(font);
+
+    return error;
+}
+
+vg_lite_error_t vg_lite_destroy_glyph_atlas(vg_lite_font_t font)
+{
+    glyph_atlas_t *atlas;
+
+    atlas = find_glyph_atlas(font);
+    if (atlas == NULL)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    /* GPU may still be reading from the atlas */
+    vg_lite_finish();
+    vg_lite_free(&atlas->buffer);
+    _mem_free(atlas->glyphs);
+    _mem_free(atlas->scratch);
+    memset(atlas, 0, sizeof(*atlas));
+
+    return VG_LITE_SUCCESS;
+}
+
+vg_lite_error_t vg_lite_get_glyph_atlas_info(vg_lite_font_t font,
+                                             vg_lite_glyph_atlas_info_t *info)
+{
+    glyph_atlas_t *atlas;
+    atlas_shelf_t *last;
+
+    atlas = find_glyph_atlas(font);
+    if (atlas == NULL || info == NULL)
+        return VG_LITE_INVALID_ARGUMENT;
+
+    info->width = atlas->buffer.width;
+    info->height = atlas->buffer.height;
+    info->glyph_count = atlas->glyph_count;
+    info->used_pixels = atlas->used_pixels;
+    info->packed_height = 0;
+    if (atlas->shelf_count != 0) {
+        last = &atlas->shelves[atlas->shelf_count - 1];
+        info->packed_height = last->y + last->height;
+    }
+    info->occupancy = (int)((atlas->used_pixels * 100u) /
+                            ((uint32_t)info->width * info->height));
+
+    return VG_LITE_SUCCESS;
+}
+
+/* Blit every glyph of a layout out of the atlas, no CPU rasterization.
+ * Returns VG_LITE_OUT_OF_RESOURCES or VG_LITE_OUT_OF_MEMORY without
+ * drawing anything if a glyph can not be added to the atlas. */
+static vg_lite_error_t draw_text_from_atlas(vg_lite_buffer_t *target,
+                                            glyph_atlas_t *atlas,
+                                            const vg_lite_text_layout_t *layout,
+                                            vg_lite_matrix_t *matrix,
+                                            vg_lite_blend_t blend,
+                                            vg_lite_font_attributes_t *attributes)
+{
+    const vg_lite_text_glyph_t *glyph;
+    const atlas_glyph_t *entry;
+    vg_lite_matrix_t m_glyph;
+    vg_lite_color_t color;
+    vg_lite_error_t error;
+    uint32_t rect[4];
+    int i;
+
+    /* Insert missing glyphs first, so a full atlas never draws half a text */
+    for (i = 0; i < layout->glyph_count; i++) {
+        error = atlas_insert(atlas, layout->glyphs[i].character, NULL);
+        if (error != VG_LITE_SUCCESS)
+            return error;
+    }
+
+    color = attributes->text_color | 0xff000000;
+    for (i = 0; i < layout->glyph_count; i++) {
+        glyph = &layout->glyphs[i];
+        atlas_insert(atlas, glyph->character, &entry);
+        if (entry->width == 0)
+            continue;
+
+        rect[0] = entry->x;
+        rect[1] = entry->y;
+        rect[2] = entry->width;
+        rect[3] = entry->height;
+
+        memcpy(&m_glyph, matrix, sizeof(m_glyph));
+        vg_lite_translate(attributes->anchor + glyph->x + entry->dx,
+                          2 + glyph->y + entry->dy, &m_glyph);
+        error = vg_lite_blit_rect(target, &atlas->buffer, rect, &m_glyph,
+                                  blend, color, VG_LITE_FILTER_POINT);
+        if (error != VG_LITE_SUCCESS)
+            return error;
+    }
+
+    return VG_LITE_SUCCESS;
+}
+
+/* Draw text with font data already held by the caller */
+static vg_lite_error_t draw_text_resident(vg_lite_buffer_t *target,
+                                          char *text,
+                                          vg_lite_font_t font,
+                                          int x,
+                                          int y,
+                                          vg_lite_matrix_t *matrix,
+                                          vg_lite_blend_t blend,
+                                          vg_lite_font_attributes_t *attributes)
 {
     vg_lite_error_t error;
-    int height;
     text_context_t ctx_text;
     vg_lite_matrix_t m_text;
     int text_img_size = 0;
-    font_face_desc_t* font_face = NULL;
-    int text_width_in_pixels = 0;
-    int tmpX;
+    const vg_lite_text_layout_t *layout;
+    const vg_lite_text_glyph_t *glyph;
+    glyph_atlas_t *atlas;
+    int i;
 
     memset(&ctx_text, 0, sizeof(ctx_text));
     ctx_text.attributes = attributes;
-    
-    if ( vg_lite_is_font_valid(font) != 0 ) {
-        return VG_LITE_INVALID_ARGUMENT;
-    }
-    
-    error = vg_lite_load_font_data(font,
-                                 attributes->font_height); 
-    if ( error != 0 ) {
-        return VG_LITE_INVALID_ARGUMENT;
-    }
 
     if(attributes->tspan_has_dx_dy != 0)
     {
@@ -245,54 +981,72 @@ vg_lite_error_t vg_lite_draw_text(vg_lite_buffer_t *target,
 
     // Dynamic decision
     if ( attributes->is_vector_font == 0 ) {
-        init_256pallet_color_table(attributes->bg_color, attributes->text_color);
-
-        /* Application specifies actual font by reading proper rcd file */
-        ctx_text.rcd_font = _vg_lite_get_raster_font(font);
-
-        /* Count number of lines to decide font buffer size. */
-        height = 0;
-        mf_text_draw_area(ctx_text.rcd_font, attributes->width - 2 * attributes->margin,
-                    text, &height, &text_width_in_pixels);
-        height *= attributes->font_height;
-        height += 4;
+        /* Line breaks and glyph positions come from the layout cache,
+         * unchanged text is never measured again */
+        error = vg_lite_get_text_layout(text, font, attributes, &layout);
+        if ( error != VG_LITE_SUCCESS ) {
+            return error;
+        }
 
         if( attributes->tspan_has_dx_dy == 0) {
             y -= attributes->font_height;
         }
 
-        tmpX = x;
-        if(attributes->alignment == eTextAlignCenter) {
-            tmpX -= text_width_in_pixels/2;
-        } else if(attributes->alignment == eTextAlignRight) {
-            tmpX -= text_width_in_pixels;
+        attributes->last_dx = layout->advance;
+        if ( layout->glyph_count == 0 ) {
+            /* Nothing to render, only the pen moves */
+            attributes->last_x = x;
+            attributes->last_y = y;
+            return VG_LITE_SUCCESS;
+        }
+
+        /* Lines are aligned against each other inside the layout, the
+         * block itself is aligned to x when it is placed on the target */
+        if(layout->alignment == eTextAlignCenter) {
+            x -= layout->width/2;
+        } else if(layout->alignment == eTextAlignRight) {
+            x -= layout->width;
+        }
+
+        vg_lite_identity(&m_text);
+        matrix_multiply(&m_text, matrix);
+        vg_lite_translate(x, y, &m_text);
+
+        /* Pre-rendered glyphs are blitted straight from the atlas. The atlas
+         * outlives this call, so there is no need to wait for the GPU. */
+        atlas = find_glyph_atlas(font);
+        if ( atlas != NULL ) {
+            error = draw_text_from_atlas(target, atlas, layout, &m_text,
+                                         blend, attributes);
+            /* A full atlas falls back to rendering the text on the CPU */
+            if ( error != VG_LITE_OUT_OF_RESOURCES &&
+                 error != VG_LITE_OUT_OF_MEMORY ) {
+                attributes->last_x = x;
+                attributes->last_y = y;
+                return error;
+            }
         }
-        /* Manually calculate X-offset for text-alignemnt; mcufont just
-         * doesn't render half part(left-part) for center alignment and
-         * full string skipped for right-alignment, So again set it to
-         * left-alignment for font-attrib, as offsets are already
-         * calculated and alignment handled in other way */
-        attributes->alignment = 0;
+
+        init_256pallet_color_table(attributes->bg_color, attributes->text_color);
+        ctx_text.rcd_font = layout->font_data;
 
         /* Allocate and initialize vg_lite_buffer that can hold font text
          * Note: ctx_text.width and ctx_text.height get used by internal
-         *   state of MF rendering engine. Based on amount of text to render
-         *   This buffer gets allocated, and buffer width gets aligned to 
-         *   16 pixel boundary  
+         *   state of MF rendering engine. Buffer width gets aligned to
+         *   16 pixel boundary
          */
-        ctx_text.width = attributes->width;
-        /* Memory optimization */
-        ctx_text.width = text_width_in_pixels;
+        ctx_text.width = layout->width + attributes->anchor;
         /* Align width to 16 pixel boundary */
         if (ctx_text.width & 15) {
             ctx_text.width += 15;
             ctx_text.width &= (~15);
         }
 
-        ctx_text.height = height;
+        ctx_text.height = layout->height + 4;
         error = alloc_font_buffer(&ctx_text.buffer, ctx_text.width, ctx_text.height);
         if ( error != VG_LITE_SUCCESS) {
             printf("WARNING: alloc_font_buffer failed(%d).\r\n",error);
+            return error;
         }
         ctx_text.y = 2;
 
@@ -306,13 +1060,14 @@ vg_lite_error_t vg_lite_draw_text(vg_lite_buffer_t *target,
                text_img_size);
 
         /* Render font text into vg_lite_buffer  */
-        mf_wordwrap(ctx_text.rcd_font, attributes->width - 2 * attributes->margin,
-                    text, line_callback, &ctx_text);
-        
+        for (i = 0; i < layout->glyph_count; i++) {
+            glyph = &layout->glyphs[i];
+            character_callback(attributes->anchor + glyph->x,
+                               ctx_text.y + glyph->y,
+                               glyph->character, &ctx_text);
+        }
+
         /* Draw font bitmap on render target */
-        vg_lite_identity(&m_text);
-        matrix_multiply(&m_text, matrix);
-        vg_lite_translate(x, y, &m_text);
         vg_lite_scale(1.0, 1.0, &m_text);
         if ( ctx_text.buffer.format == VG_LITE_ARGB8888 )
           ctx_text.buffer.stride = ctx_text.width*4;
@@ -332,7 +1087,6 @@ vg_lite_error_t vg_lite_draw_text(vg_lite_buffer_t *target,
         if ( error != VG_LITE_SUCCESS) {
             printf("WARNING: vg_lite_finish failed(%d).\r\n",error);
         }
-        attributes->last_dx = text_width_in_pixels;
     } else {
       error = (vg_lite_error_t)vg_lite_vtf_draw_text(target,
                                     x, y,
@@ -349,11 +1103,38 @@ vg_lite_error_t vg_lite_draw_text(vg_lite_buffer_t *target,
         if ( error != VG_LITE_SUCCESS) {
             printf("WARNING: vg_lite_finish failed(%d).\r\n",error);
         }
-
-        vft_unload(font_face);
     }
     attributes->last_x = x;
     attributes->last_y = y;
     
     return error;
 }
+
+vg_lite_error_t vg_lite_draw_text(vg_lite_buffer_t *target,
+                                  char *text,
+                                  vg_lite_font_t font,
+                                  int x,
+                                  int y,
+                                  vg_lite_matrix_t *matrix,
+                                  vg_lite_blend_t blend,
+                                  vg_lite_font_attributes_t *attributes)
+{
+    vg_lite_error_t error;
+
+    if ( vg_lite_is_font_valid(font) != 0 ) {
+        return VG_LITE_INVALID_ARGUMENT;
+    }
+
+    /* Font data and glyph caches stay loaded after the draw, they are only
+     * evicted when the font residency budget is exceeded */
+    error = vg_lite_acquire_font(font, attributes->font_height);
+    if ( error != 0 ) {
+        return VG_LITE_INVALID_ARGUMENT;
+    }
+
+    error = draw_text_resident(target, text, font, x, y, matrix, blend,
+                               attributes);
+
+    vg_lite_release_font(font);
+    return error;
+}
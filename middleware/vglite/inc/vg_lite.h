@@ -480,6 +480,28 @@ extern "C" {
         int32_t height; /*! Height of the rectangle. */
     } vg_lite_rectangle_t;
 
+    /*!
+     @abstract Command buffer usage statistics.
+
+     @discussion
+     A frame ends with each <code>vg_lite_end_frame</code>. A rollover is a command buffer submitted
+     because it was full, which costs a flush and the re-emission of the tessellation and
+     context states. <code>max_frame_bytes</code> is the smallest buffer size that never rolls
+     over for the frames seen, half of it gives at most one rollover per frame.
+     */
+    typedef struct vg_lite_command_buffer_stats {
+        uint32_t size;              /*! Size of each of the two command buffers in bytes. */
+        uint32_t frames;            /*! Frames since the last reset. */
+        uint32_t rollovers;         /*! Rollovers in the last frame. */
+        uint32_t max_rollovers;     /*! Most rollovers in one frame. */
+        uint32_t total_rollovers;   /*! Rollovers since the last reset. */
+        uint32_t peak_bytes;        /*! Fullest command buffer of the last frame, in bytes. */
+        uint32_t max_peak_bytes;    /*! Fullest command buffer since the last reset, in bytes. */
+        uint32_t frame_bytes;       /*! Command bytes submitted in the last frame. */
+        uint32_t max_frame_bytes;   /*! Most command bytes submitted in one frame. */
+        uint32_t resizes;           /*! Automatic command buffer resizes since the last reset. */
+    } vg_lite_command_buffer_stats_t;
+
     /*!
      @abstract Tessellation buffer information.
 
@@ -794,6 +816,47 @@ extern "C" {
      */
     vg_lite_error_t vg_lite_init(int32_t tessellation_width, int32_t tessellation_height);
 
+    /*!
+     @abstract Change the tessellation window of an initialized context.
+
+     @discussion
+     Waits for the GPU, replaces the tessellation buffer and reprograms it, without a
+     <code>vg_lite_close</code> and <code>vg_lite_init</code>. The window is aligned like in
+     {@link vg_lite_init}. All contexts share the tessellation buffer, so this is only supported
+     while a single context is open. Call it between frames. Without memory for the new window
+     the old one is kept; if even that can not be reallocated, draws return
+     <code>VG_LITE_NO_CONTEXT</code> until a later call succeeds.
+
+     @param tessellation_width
+     The width of the tessellation window.
+
+     @param tessellation_height
+     The height of the tessellation window.
+
+     @result
+     Returns the status as defined by <code>vg_lite_error_t</code>.
+     */
+    vg_lite_error_t vg_lite_set_tessellation_window(int32_t tessellation_width, int32_t tessellation_height);
+
+    /*!
+     @abstract Let the driver size the tessellation window.
+
+     @discussion
+     The bounding boxes of the drawn paths are tracked per frame, frames are delimited by
+     {@link vg_lite_end_frame}. After a frame with a path
+     larger than the window, the window grows to the largest box seen, as far as the budget
+     allows (rows are given up first). After a run of frames whose boxes would fit in half the
+     window area, it shrinks to them. Fewer tiles per path means less command traffic and
+     tessellation work. Same restrictions as {@link vg_lite_set_tessellation_window}.
+
+     @param budget
+     Memory available for the tessellation buffer, in bytes. 0 disables auto sizing.
+
+     @result
+     Returns the status as defined by <code>vg_lite_error_t</code>.
+     */
+    vg_lite_error_t vg_lite_set_tessellation_auto_size(uint32_t budget);
+
     /*!
      @abstract Destroy a vglite context.
 
@@ -805,6 +868,33 @@ extern "C" {
      */
     vg_lite_error_t vg_lite_close(void);
 
+    /*!
+     @abstract Stop the GPU between bursts of work.
+
+     @discussion
+     Finishes the work of the calling context, waits for the GPU to be idle and stops its clock.
+     Contexts, buffers, uploaded paths and the tessellation buffer stay allocated, so the GPU may
+     be power gated until {@link vg_lite_resume}. Other contexts must have finished their work
+     before, and nothing may be submitted while the GPU is suspended.
+
+     @result
+     Returns the status as defined by <code>vg_lite_error_t</code>.
+     */
+    vg_lite_error_t vg_lite_suspend(void);
+
+    /*!
+     @abstract Restart the GPU after {@link vg_lite_suspend}.
+
+     @discussion
+     Call it once the GPU is powered again. Only the clock setup and soft reset are replayed;
+     the tessellation states are programmed again and the CLUT and fast clear states are
+     reloaded with the next draw of the calling context.
+
+     @result
+     Returns the status as defined by <code>vg_lite_error_t</code>.
+     */
+    vg_lite_error_t vg_lite_resume(void);
+
     /*!
      @abstract This api explicitly submits the command buffer to GPU and waits for it to complete.
 
@@ -815,6 +905,20 @@ extern "C" {
      */
     vg_lite_error_t vg_lite_finish(void);
 
+    /*!
+     @abstract Finish the rendering of a frame.
+
+     @discussion
+     Same as {@link vg_lite_finish}, and marks the end of the frame for the command buffer
+     statistics and for auto sizing. <code>vg_lite_finish</code> is also used inside the
+     driver, e.g. before freeing a buffer the GPU may still read, so only this call closes
+     a frame. Call it once per frame, typically before presenting it.
+
+     @result
+     Returns the status as defined by <code>vg_lite_error_t</code>.
+     */
+    vg_lite_error_t vg_lite_end_frame(void);
+
     /*!
      @abstract This api explicitly submits the command buffer to GPU without waiting for it to complete.
 
@@ -825,6 +929,19 @@ extern "C" {
      */
     vg_lite_error_t vg_lite_flush(void);
 
+    /*!
+     @abstract Order the GPU writes issued so far before the commands issued after this call.
+
+     @discussion
+     Flushes the pixel engine and stalls the command stream, so a buffer just rendered can be
+     used as an image or pattern, or rendered again while earlier draws still read it. Nothing
+     is submitted and the CPU does not wait.
+
+     @result
+     Returns the status as defined by <code>vg_lite_error_t</code>.
+     */
+    vg_lite_error_t vg_lite_barrier(void);
+
     /*!
      @abstract Draw a path to a target buffer.
 
@@ -1491,6 +1608,62 @@ extern "C" {
      */
     vg_lite_error_t vg_lite_set_command_buffer_size(uint32_t size);
 
+    /*!
+     @abstract Let the driver size the command buffers.
+
+     @discussion
+     After each frame, ended by {@link vg_lite_end_frame}, the two command buffers are grown
+     when the frame rolled over more
+     than once, and shrunk after a run of frames that would fit in less than half of them.
+     The size follows the submitted command bytes with some headroom, so a frame rolls over
+     at most once. <code>vg_lite_set_command_buffer_size</code> still sets the size directly.
+
+     @param budget
+     Memory available for both command buffers together, in bytes. 0 disables auto sizing.
+
+     @result
+     Returns the status as defined by <code>vg_lite_error_t</code>.
+     */
+    vg_lite_error_t vg_lite_set_command_buffer_auto_size(uint32_t budget);
+
+    /*!
+     @abstract Get the command buffer usage statistics of the calling context.
+
+     @param stats
+     Pointer to a <code>vg_lite_command_buffer_stats_t</code> structure that receives the statistics.
+
+     @result
+     Returns the status as defined by <code>vg_lite_error_t</code>.
+     */
+    vg_lite_error_t vg_lite_get_command_buffer_stats(vg_lite_command_buffer_stats_t *stats);
+
+    /*!
+     @abstract Clear the command buffer usage statistics of the calling context.
+
+     @result
+     Returns the status as defined by <code>vg_lite_error_t</code>.
+     */
+    vg_lite_error_t vg_lite_reset_command_buffer_stats(void);
+
+    /*!
+     @abstract Set the submit priority of the current task.
+
+     @discussion
+     When several tasks share the GPU, command buffers waiting to be executed
+     are started by priority instead of in submit order; tasks of equal
+     priority are served first come first served. A buffer of a higher
+     priority task waits at most for the running buffer and the one queued
+     right behind it by the same task. The default priority is 0. Only
+     supported in multi-task RTOS builds.
+
+     @param priority
+     The priority, higher values are served first.
+
+     @result
+     Returns the status as defined by <code>vg_lite_error_t</code>.
+     */
+    vg_lite_error_t vg_lite_set_context_priority(uint32_t priority);
+
     /*!
      @abstract Set scissor used for render target's boundary.
 
@@ -1519,6 +1692,31 @@ extern "C" {
       Returns the status as defined by <code>vg_lite_error_t</code>.*/
     vg_lite_error_t vg_lite_disable_scissor(void);
 
+    /*!
+      @abstract Enable deferred rendering.
+
+      @discussion
+      Draw, blit and clear calls are recorded instead of being sent to the command buffer.
+      Each render target collects its calls into passes, ordered only by real dependencies
+      (a pass reading a buffer comes after the pass rendering it). On <code>vg_lite_flush</code>,
+      <code>vg_lite_finish</code>, <code>vg_lite_free</code>, <code>vg_lite_set_CLUT</code> or
+      <code>vg_lite_disable_deferred</code> the passes are replayed so that draws to one target are
+      grouped, which avoids re-programming the target and fast clear cache for interleaved draws.
+      Scissor and premultiply states are captured per call; paths, buffers and gradients are
+      referenced and must stay valid until the recorded calls are replayed.
+      A call that fails on replay returns its error from the call that triggered the replay.
+
+      @result
+      Returns the status as defined by <code>vg_lite_error_t</code>.*/
+    vg_lite_error_t vg_lite_enable_deferred(void);
+
+    /*!
+      @abstract Replay the recorded calls and disable deferred rendering.
+
+      @result
+      Returns the status as defined by <code>vg_lite_error_t</code>.*/
+    vg_lite_error_t vg_lite_disable_deferred(void);
+
     /*!
       @abstract query the remaining allocate contiguous video memory.
 
@@ -194,6 +194,81 @@ extern "C" {
         int last_dx;     /*! Horizontal width of text in pixels, for last text */
     } vg_lite_font_attributes_t;
 
+    /*!
+     @abstract Position of one laid out glyph
+
+     @discussion
+     Glyph coordinates are relative to the top-left corner of the text
+     layout and already include alignment, justification and kerning.
+     */
+    typedef struct vg_lite_text_glyph {
+        int16_t  x;         /*! Left edge of the glyph cell in pixels */
+        int16_t  y;         /*! Top edge of the glyph cell in pixels */
+        uint16_t character; /*! Unicode character of the glyph */
+        uint16_t offset;    /*! Byte offset of the character in the text */
+        uint8_t  advance;   /*! Tracking width of the glyph in pixels */
+    } vg_lite_text_glyph_t;
+
+    /*!
+     @abstract One line of a text layout
+     */
+    typedef struct vg_lite_text_line {
+        uint16_t first_glyph; /*! Index of the first glyph of the line */
+        uint16_t glyph_count; /*! Number of glyphs on the line */
+        uint16_t offset;      /*! Byte offset of the line start in the text */
+        uint16_t chars;       /*! Number of characters wrapped onto the line */
+        int16_t  x;           /*! Left edge of the inked line in pixels */
+        int16_t  width;       /*! Width of the line without trailing spaces */
+    } vg_lite_text_line_t;
+
+    /*!
+     @abstract Laid out raster text
+
+     @discussion
+     A text layout holds the line breaks, glyph positions and bounding box of
+     a string rendered with a raster font. Layouts are produced in one pass
+     by <code>vg_lite_get_text_layout</code> and kept in a small cache keyed
+     by font, text, wrap width, alignment and justification, so unchanged
+     paragraphs are never laid out twice.
+
+     The layout is owned by the driver. It stays valid until it is evicted
+     from the cache by newer text, or until its font is unloaded.
+     */
+    typedef struct vg_lite_text_layout {
+        /* Cache key */
+        vg_lite_font_t font;       /*! Font handle used for the layout */
+        const void *font_data;     /*! Loaded font the layout refers to */
+        uint32_t hash;             /*! Hash of the text */
+        char *text;                /*! Private copy of the laid out text */
+        int16_t wrap_width;        /*! Maximum line width in pixels */
+        uint8_t alignment;         /*! eTextAlign_t used for the lines */
+        uint8_t justify;           /*! Non-zero when lines are justified */
+
+        /* Layout result */
+        uint16_t line_height;      /*! Vertical advance between lines */
+        uint16_t line_count;       /*! Number of lines */
+        uint16_t glyph_count;      /*! Number of positioned glyphs */
+        int16_t  width;            /*! Bounding box width in pixels */
+        int16_t  height;           /*! Bounding box height in pixels */
+        int16_t  advance;          /*! Widest line including trailing spaces */
+        vg_lite_text_line_t *lines;
+        vg_lite_text_glyph_t *glyphs;
+
+        uint32_t last_used;        /*! LRU stamp of the cache entry */
+    } vg_lite_text_layout_t;
+
+    /*!
+     @abstract Occupancy of a glyph atlas
+     */
+    typedef struct vg_lite_glyph_atlas_info {
+        int width;         /*! Atlas width in pixels */
+        int height;        /*! Atlas height in pixels */
+        int glyph_count;   /*! Number of glyphs in the atlas, including blank ones */
+        int used_pixels;   /*! Area covered by packed glyph boxes */
+        int packed_height; /*! Rows used from the top of the atlas */
+        int occupancy;     /*! used_pixels in percent of the atlas area */
+    } vg_lite_glyph_atlas_info_t;
+
   /* API Function prototypes ****************************************************/
 
     /*!
@@ -360,6 +435,194 @@ extern "C" {
         eFontStyle_t   font_style,
         int font_height);
 
+    /*!
+     @abstract Lays out text for a raster font.
+
+     @discussion
+     Word wraps <code>text</code> to <code>attributes->width</code> minus the
+     left and right margins, and positions every glyph according to the
+     alignment and justification attributes. The result is cached, so asking
+     again for the same text, font and width returns the existing layout
+     without measuring a single character.
+
+     The layout can be used to size buffers, to render the text and to map
+     points back to characters with <code>vg_lite_text_hit_test</code>.
+
+     @param text
+     Text to lay out
+
+     @param font
+     Font handle of a registered raster font
+
+     @param attributes
+     Font attributes that control wrapping and alignment
+
+     @param layout
+     Receives a pointer to the driver owned layout
+
+     @result
+     Returns the status as defined by <code>vg_lite_error_t</code>.
+        VG_LITE_SUCCESS when the layout is available
+        VG_LITE_INVALID_ARGUMENT if the font is invalid or not a raster font
+        VG_LITE_OUT_OF_MEMORY if the layout can not be allocated
+     */
+    vg_lite_error_t vg_lite_get_text_layout(
+                      char *text,
+                      vg_lite_font_t font,
+                      vg_lite_font_attributes_t *attributes,
+                      const vg_lite_text_layout_t **layout);
+
+    /*!
+     @abstract Finds the character under a point of a text layout.
+
+     @param layout
+     Layout returned by <code>vg_lite_get_text_layout</code>
+
+     @param x
+     x position in pixels relative to the layout origin
+
+     @param y
+     y position in pixels relative to the layout origin
+
+     @result
+     Byte offset of the character in the laid out text, or -1 when the point
+     is not over any glyph.
+     */
+    int vg_lite_text_hit_test(
+                      const vg_lite_text_layout_t *layout,
+                      int x,
+                      int y);
+
+    /*!
+     @abstract Drops cached text layouts.
+
+     @discussion
+     Releases every cached layout that was built with <code>font</code>.
+     Passing VG_LITE_INVALID_FONT releases the whole cache.
+     */
+    void vg_lite_flush_text_layouts(vg_lite_font_t font);
+
+    /*!
+     @abstract Pre-renders glyphs of a raster font into a GPU atlas.
+
+     @discussion
+     Decodes the glyphs once into an A8 image of <code>width</code> x
+     <code>height</code> pixels. From then on <code>vg_lite_draw_text</code>
+     draws text of this font as sub-rectangle blits out of the atlas, tinted
+     with the text color, without rasterizing anything on the CPU and without
+     waiting for the GPU. Glyphs used by a text that are not in the atlas yet
+     are added on demand. If the atlas is full the text is rendered the
+     regular way.
+
+     The atlas is released together with the font data.
+
+     @param font
+     Font handle of a registered raster font
+
+     @param width
+     Width of the atlas in pixels, aligned up to 16
+
+     @param height
+     Height of the atlas in pixels
+
+     @param characters
+     UTF-8 string with the characters to pre-render, or NULL for every glyph
+     of the font
+
+     @result
+     Returns the status as defined by <code>vg_lite_error_t</code>.
+     On any error no atlas is created. VG_LITE_OUT_OF_RESOURCES means not all
+     requested glyphs fit into the atlas, retry with a larger size or with a
+     shorter <code>characters</code> list.
+     */
+    vg_lite_error_t vg_lite_create_glyph_atlas(
+                      vg_lite_font_t font,
+                      int width,
+                      int height,
+                      char *characters);
+
+    /*!
+     @abstract Adds glyphs to the atlas of a font.
+
+     @param font
+     Font handle with an atlas
+
+     @param characters
+     UTF-8 string with the characters to add; glyphs already present are
+     skipped
+
+     @result
+     VG_LITE_OUT_OF_RESOURCES when the atlas has no room left.
+     */
+    vg_lite_error_t vg_lite_glyph_atlas_insert(
+                      vg_lite_font_t font,
+                      char *characters);
+
+    /*!
+     @abstract Reports how full the atlas of a font is.
+     */
+    vg_lite_error_t vg_lite_get_glyph_atlas_info(
+                      vg_lite_font_t font,
+                      vg_lite_glyph_atlas_info_t *info);
+
+    /*!
+     @abstract Releases the atlas of a font.
+
+     @discussion
+     Waits for the GPU to finish, since pending blits may still read from
+     the atlas.
+     */
+    vg_lite_error_t vg_lite_destroy_glyph_atlas(vg_lite_font_t font);
+
+    /*!
+     @abstract Holds a font loaded.
+
+     @discussion
+     Loads the font data on first use and increments its reference count.
+     A font that is referenced is never unloaded for memory reasons.
+     <code>vg_lite_draw_text</code> acquires and releases the font itself,
+     applications only need this API to keep a font loaded across draws,
+     e.g. while it has a glyph atlas.
+
+     @param font
+     Font handle
+
+     @param font_height
+     Requested font height, must match the height of raster fonts
+
+     @result
+     Returns the status as defined by <code>vg_lite_error_t</code>.
+     */
+    vg_lite_error_t vg_lite_acquire_font(vg_lite_font_t font, int font_height);
+
+    /*!
+     @abstract Releases a font acquired with <code>vg_lite_acquire_font</code>.
+
+     @discussion
+     The font data and its cached glyphs stay loaded. Fonts nobody holds
+     are unloaded, least recently used first, only when the loaded fonts
+     use more heap than the residency budget.
+     */
+    vg_lite_error_t vg_lite_release_font(vg_lite_font_t font);
+
+    /*!
+     @abstract Sets the heap budget for loaded fonts.
+
+     @discussion
+     The default is VG_LITE_FONT_RESIDENCY_BUDGET bytes. Fonts that are not
+     held are unloaded until the loaded fonts fit into the new budget.
+     */
+    void vg_lite_set_font_budget(int bytes);
+
+    /*!
+     @abstract Unloads every font that is not held.
+
+     @discussion
+     Intended for low memory situations, fonts are loaded again on their
+     next use.
+     */
+    void vg_lite_trim_font_memory(void);
+
     /*!
      @abstract Initializes support for text drawing.
      */